@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../xopt.h"
+
+/*
+	Checks the other ways into the parser against xopt_parse_r():
+	xopt_parse_buf() with too small a buffer, xopt_parse_cb() handing out
+	extras (and stopping when told to) and xopt_iter_init() / xopt_next()
+	walking the same options and extras, condensed shorts and `--' included.
+*/
+
+#define LOG_SIZE 16
+
+/* every option and extra, in the order they were seen */
+typedef struct {
+	const xoptOption *options[LOG_SIZE];
+	const char *values[LOG_SIZE];
+	int argis[LOG_SIZE];
+	int count;
+	const char *stopAt;
+} Log;
+
+static void record(const char *value, void *data, const xoptOption *option,
+		bool longArg, const char **err) {
+	Log *log = (Log*) data;
+	(void) longArg;
+	(void) err;
+
+	if (log->count < LOG_SIZE) {
+		log->options[log->count] = option;
+		log->values[log->count] = value;
+		log->argis[log->count] = -1;
+		++log->count;
+	}
+}
+
+static void recordExtra(const char *extra, int argi, void *callbackData,
+		const char **err) {
+	Log *log = (Log*) callbackData;
+
+	if (log->stopAt && !strcmp(extra, log->stopAt)) {
+		*err = "stop here";
+		return;
+	}
+
+	record(extra, log, 0, false, err);
+	log->argis[log->count - 1] = argi;
+}
+
+xoptOption options[] = {
+	{
+		0,
+		'a',
+		0,
+		&record,
+		XOPT_TYPE_BOOL,
+		0,
+		"Flag a",
+		0
+	},
+	{
+		0,
+		'b',
+		0,
+		&record,
+		XOPT_TYPE_BOOL,
+		0,
+		"Flag b",
+		0
+	},
+	{
+		"num",
+		'n',
+		0,
+		&record,
+		XOPT_TYPE_INT,
+		"n",
+		"A number",
+		0
+	},
+	{
+		"name",
+		0,
+		0,
+		&record,
+		XOPT_TYPE_STRING,
+		"name",
+		"A name",
+		0
+	},
+	XOPT_NULLOPTION
+};
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what) {
+	if (!ok) {
+		printf("FAIL %s\n", what);
+		++failures;
+	}
+}
+
+static bool sameValue(const char *a, const char *b) {
+	return a == b || (a && b && !strcmp(a, b));
+}
+
+static void compare(const xoptContext *ctx, int argc, const char **argv,
+		const char *what) {
+	/* xopt_next() must see what xopt_parse_r() applies, in the same order,
+		 and fail in the same place */
+	Log log;
+	xoptResult res;
+	xoptIterator it;
+	const xoptOption *option;
+	const char *value;
+	int kind, n = 0, extra = 0;
+	bool ok, same = true;
+
+	memset(&log, 0, sizeof(log));
+	ok = xopt_parse_r(ctx, argc, argv, &log, &res);
+
+	xopt_iter_init(&it, ctx, argc, argv);
+	while ((kind = xopt_next(&it, &option, &value)) > 0) {
+		if (kind == XOPT_NEXT_EXTRA) {
+			/* a failed parse keeps no extras to compare with */
+			same = same && option == 0 && argv[it.argi] == value
+				&& (!ok || (extra < res.extrasCount && res.extras[extra] == value));
+			++extra;
+			continue;
+		}
+
+		same = same && n < log.count && log.options[n] == option
+			&& sameValue(log.values[n], value);
+		++n;
+	}
+
+	if (ok) {
+		same = same && kind == XOPT_NEXT_END && n == log.count
+			&& extra == res.extrasCount;
+	} else {
+		same = same && kind == XOPT_NEXT_ERROR
+			&& it.error.code == res.error.code && it.error.argi == res.error.argi;
+	}
+
+	expect(same, what);
+	xopt_result_free(&res);
+}
+
+int main(void) {
+	const char *err = 0;
+	xoptContext *ctx;
+	Log log;
+	xoptResult res;
+	const char *buf[8];
+	bool ok;
+	int i, n;
+
+	const char *args[] = {"api-test", "one", "-ab", "-n", "5", "two",
+		"--name=x", "-ban", "7", "three", "--", "-a", "four"};
+	const char *invalid[] = {"api-test", "one", "-a", "--bogus", "two"};
+	const char *notLast[] = {"api-test", "-nab", "1"};
+	const int argis[] = {1, 5, 9, 11, 12};
+
+	ctx = xopt_context("api-test", options, XOPT_CTX_STRICT, &err);
+	if (err) {
+		fprintf(stderr, "Error: %s\n", err);
+		return 1;
+	}
+
+	/* a buffer without room for the terminator still gets the whole command
+		 line parsed, and says how many extras there are */
+	memset(&log, 0, sizeof(log));
+	ok = xopt_parse_buf(ctx, 13, args, &log, buf, 5, &res);
+	expect(!ok && res.error.code == XOPT_ERR_NOSPACE, "5 slots are too few");
+	expect(res.extrasCount == 5, "5 slots: the extras are still counted");
+	expect(log.count == 7, "5 slots: the options are still applied");
+	xopt_result_free(&res);
+
+	memset(&log, 0, sizeof(log));
+	ok = xopt_parse_buf(ctx, 13, args, &log, buf, 6, &res);
+	expect(ok && res.extrasCount == 5 && res.extras == buf && !res.ownsExtras,
+			"6 slots are enough");
+	expect(!strcmp(buf[0], "one") && !strcmp(buf[3], "-a")
+			&& !strcmp(buf[4], "four") && !buf[5], "6 slots: the extras");
+	xopt_result_free(&res);
+
+	/* extras are streamed with their index in argv */
+	memset(&log, 0, sizeof(log));
+	ok = xopt_parse_cb(ctx, 13, args, &log, &recordExtra, &log, &res);
+	expect(ok && res.extrasCount == 5 && !res.extras, "xopt_parse_cb succeeds");
+	for (i = n = 0; i < log.count; i++) {
+		if (log.argis[i] >= 0) {
+			expect(n < 5 && log.argis[i] == argis[n++]
+					&& log.values[i] == args[log.argis[i]], "extra argv index");
+		}
+	}
+	expect(n == 5, "every extra is streamed");
+	xopt_result_free(&res);
+
+	/* and a callback error stops the parse where it happened */
+	memset(&log, 0, sizeof(log));
+	log.stopAt = "three";
+	ok = xopt_parse_cb(ctx, 13, args, &log, &recordExtra, &log, &res);
+	expect(!ok && res.error.code == XOPT_ERR_CALLBACK && res.error.argi == 9
+			&& res.error.message && !strcmp(res.error.message, "stop here"),
+			"a callback error fails the parse at its extra");
+	expect(log.count == 9, "nothing after the failing extra is seen");
+	xopt_result_free(&res);
+
+	/* the iterator agrees with the parser */
+	compare(ctx, 13, args, "xopt_next matches xopt_parse_r");
+	compare(ctx, 5, invalid, "xopt_next fails like xopt_parse_r");
+	compare(ctx, 3, notLast, "xopt_next fails like xopt_parse_r (-nab)");
+	compare(ctx, 1, args, "xopt_next on an empty command line");
+
+	printf("%d failures\n", failures);
+	xopt_context_free(ctx);
+	return failures ? 2 : 0;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../xopt.h"
+
+/*
+	Runs a deliberately skewed batch (a few huge command lines up front, then
+	thousands of tiny ones, some of them invalid) through xopt_parse_batch()
+	and xopt_parse_batch_mt() with various thread counts; the results, data
+	objects and extras must come out identical. Worth building with
+	-fsanitize=thread as well.
+*/
+
+#define LINES 3000
+#define HEAVY_LINES 8
+#define HEAVY_ARGS 20000
+#define ROUNDS 8
+
+typedef struct {
+	int number;
+	const char *name;
+	bool verbose;
+} BatchConfig;
+
+xoptOption options[] = {
+	{
+		"number",
+		'n',
+		offsetof(BatchConfig, number),
+		0,
+		XOPT_TYPE_INT,
+		"n",
+		"A number",
+		0
+	},
+	{
+		"name",
+		'N',
+		offsetof(BatchConfig, name),
+		0,
+		XOPT_TYPE_STRING,
+		"s",
+		"A name",
+		0
+	},
+	{
+		"verbose",
+		'v',
+		offsetof(BatchConfig, verbose),
+		0,
+		XOPT_TYPE_BOOL,
+		0,
+		"Be verbose",
+		0
+	},
+	XOPT_NULLOPTION
+};
+
+static int compare(const BatchConfig *configA, const xoptResult *resultsA,
+		const BatchConfig *configB, const xoptResult *resultsB) {
+	int failures = 0;
+	size_t i;
+	int j;
+
+	for (i = 0; i < LINES; i++) {
+		const xoptResult *a = &resultsA[i], *b = &resultsB[i];
+		bool same = a->error.code == b->error.code
+			&& a->error.argi == b->error.argi
+			&& configA[i].number == configB[i].number
+			&& configA[i].name == configB[i].name
+			&& configA[i].verbose == configB[i].verbose;
+
+		if (same && !a->error.code) {
+			same = a->extrasCount == b->extrasCount;
+			for (j = 0; same && j <= a->extrasCount; j++) {
+				same = a->extras[j] == b->extras[j];
+			}
+		}
+
+		if (!same) {
+			printf("FAIL line %lu differs\n", (unsigned long) i);
+			++failures;
+		}
+	}
+
+	return failures;
+}
+
+int main(void) {
+	int result = 0, failures = 0;
+	const char *err = 0;
+	xoptContext *ctx;
+	int *argc;
+	const char ***argv;
+	const char **heavy, **extrasA, **extrasB;
+	BatchConfig *configA, *configB;
+	xoptResult *resultsA, *resultsB;
+	size_t i, extrasSize = 0, failedA, failedB;
+	unsigned threads;
+	int j, round;
+
+	static const char *light[][6] = {
+		{"batch-test", "-n", "1", "file", 0},
+		{"batch-test", "--name=x", "-v", "a", "b", 0},
+		{"batch-test", "--number=12", "c", 0},
+		{"batch-test", "--number=nope", 0},
+		{"batch-test", "--bogus", "d", 0},
+		{"batch-test", "e", "f", "g", "-v", 0}
+	};
+
+	ctx = xopt_context("batch-test", options, XOPT_CTX_STRICT, &err);
+	if (err) {
+		fprintf(stderr, "Error: %s\n", err);
+		return 1;
+	}
+
+	argc = malloc(sizeof(*argc) * LINES);
+	argv = malloc(sizeof(*argv) * LINES);
+	heavy = malloc(sizeof(*heavy) * (HEAVY_ARGS + 1));
+	configA = malloc(sizeof(*configA) * LINES);
+	configB = malloc(sizeof(*configB) * LINES);
+	resultsA = malloc(sizeof(*resultsA) * LINES);
+	resultsB = malloc(sizeof(*resultsB) * LINES);
+	if (!argc || !argv || !heavy || !configA || !configB || !resultsA
+			|| !resultsB) {
+		fprintf(stderr, "Error: could not allocate the batch\n");
+		return 1;
+	}
+
+	/* the heavy lines all land in the first worker's initial range, so the
+		 other workers finish early and have to steal from it */
+	heavy[0] = "batch-test";
+	for (j = 1; j < HEAVY_ARGS; j++) {
+		heavy[j] = j % 100 ? "file" : "-v";
+	}
+	heavy[HEAVY_ARGS] = 0;
+
+	for (i = 0; i < LINES; i++) {
+		if (i < HEAVY_LINES) {
+			argv[i] = heavy;
+			argc[i] = HEAVY_ARGS;
+		} else {
+			argv[i] = light[i % (sizeof(light) / sizeof(light[0]))];
+			for (argc[i] = 0; argv[i][argc[i]]; argc[i]++);
+		}
+		extrasSize += argc[i] + 1;
+	}
+
+	extrasA = malloc(sizeof(*extrasA) * extrasSize);
+	extrasB = malloc(sizeof(*extrasB) * extrasSize);
+	if (!extrasA || !extrasB) {
+		fprintf(stderr, "Error: could not allocate the extras\n");
+		return 1;
+	}
+
+	memset(configA, 0, sizeof(*configA) * LINES);
+	failedA = xopt_parse_batch(ctx, LINES, argc, argv, configA,
+			sizeof(*configA), extrasA, resultsA);
+
+	for (round = 0; round < ROUNDS; round++) {
+		for (threads = 1; threads <= 8; threads *= 2) {
+			memset(configB, 0, sizeof(*configB) * LINES);
+			failedB = xopt_parse_batch_mt(ctx, LINES, argc, argv, configB,
+					sizeof(*configB), extrasB, resultsB, threads);
+
+			if (failedA != failedB) {
+				printf("FAIL %u threads: %lu failed lines, expected %lu\n",
+						threads, (unsigned long) failedB, (unsigned long) failedA);
+				++failures;
+			}
+
+			failures += compare(configA, resultsA, configB, resultsB);
+			for (i = 0; i < LINES; i++) {
+				xopt_result_free(&resultsB[i]);
+			}
+		}
+	}
+
+	printf("%d failures\n", failures);
+	if (failures) {
+		result = 2;
+	}
+
+	for (i = 0; i < LINES; i++) {
+		xopt_result_free(&resultsA[i]);
+	}
+
+	free(extrasA);
+	free(extrasB);
+	free(resultsA);
+	free(resultsB);
+	free(configA);
+	free(configB);
+	free(heavy);
+	free(argv);
+	free(argc);
+	xopt_context_free(ctx);
+	return result;
+}
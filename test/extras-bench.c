@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../xopt.h"
+
+/*
+	Parses command lines of 1k..1M extra arguments and prints the time per
+	argument, which should stay flat as the argument count grows.
+*/
+
+#define MAX_ARGS (1024L * 1024L)
+
+typedef struct {
+	bool verbose;
+} BenchConfig;
+
+xoptOption options[] = {
+	{
+		"verbose",
+		'v',
+		offsetof(BenchConfig, verbose),
+		0,
+		XOPT_TYPE_BOOL,
+		0,
+		"Be verbose",
+		0
+	},
+	XOPT_NULLOPTION
+};
+
+int main(void) {
+	int result = 0;
+	const char *err = 0;
+	xoptContext *ctx;
+	BenchConfig config;
+	const char **argv;
+	long argc, i;
+
+	ctx = xopt_context("extras-bench", options, XOPT_CTX_STRICT, &err);
+	if (err) {
+		fprintf(stderr, "Error: %s\n", err);
+		return 1;
+	}
+
+	argv = malloc(sizeof(*argv) * (MAX_ARGS + 1));
+	if (!argv) {
+		fprintf(stderr, "Error: could not allocate argv\n");
+		xopt_context_free(ctx);
+		return 1;
+	}
+
+	argv[0] = "extras-bench";
+	for (i = 1; i <= MAX_ARGS; i++) {
+		argv[i] = "file.txt";
+	}
+
+	printf("%10s %12s %12s\n", "args", "total ms", "ns/arg");
+	for (argc = 1024; argc <= MAX_ARGS; argc *= 2) {
+		xoptResult res;
+		clock_t start;
+		double ms;
+
+		config.verbose = 0;
+
+		start = clock();
+		if (!xopt_parse_r(ctx, (int) argc + 1, argv, &config, &res)) {
+			char buf[256];
+			fprintf(stderr, "Error: %s\n", xopt_strerror(&res.error, buf, sizeof(buf)));
+			result = 2;
+			break;
+		}
+		ms = (double) (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+		if (res.extrasCount != argc) {
+			fprintf(stderr, "Error: expected %ld extras, got %d\n", argc,
+					res.extrasCount);
+			result = 3;
+		}
+
+		printf("%10ld %12.3f %12.2f\n", argc, ms, ms * 1000000.0 / argc);
+		xopt_result_free(&res);
+	}
+
+	free(argv);
+	xopt_context_free(ctx);
+	return result;
+}
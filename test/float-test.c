@@ -0,0 +1,307 @@
+#define _ISOC99_SOURCE /* strtof */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <locale.h>
+#include <time.h>
+
+#include "../xopt.h"
+
+/*
+	Differential test of XOPT_TYPE_DOUBLE / XOPT_TYPE_FLOAT parsing against
+	strtod / strtof: every result must be bitwise identical (or a range error
+	where strtod overflows). Afterwards, compares throughput of the two.
+*/
+
+#define RANDOM_CASES 200000
+#define BENCH_VALUES 100000
+#define BENCH_ROUNDS 10
+
+typedef struct {
+	double d;
+	float f;
+} FloatConfig;
+
+xoptOption options[] = {
+	{
+		"double",
+		'd',
+		offsetof(FloatConfig, d),
+		0,
+		XOPT_TYPE_DOUBLE,
+		"n",
+		"A double",
+		0
+	},
+	{
+		"float",
+		'f',
+		offsetof(FloatConfig, f),
+		0,
+		XOPT_TYPE_FLOAT,
+		"n",
+		"A float",
+		0
+	},
+	XOPT_NULLOPTION
+};
+
+static const char *edgeCases[] = {
+	"0", "-0", "+0", "0.0", ".0", "0.", "00000.00000e99999", "1", "-1", "1.5",
+	"0.1", "0.2", "0.3", "3.14159265358979323846264338327950288", "1e23",
+	"8.98846567431158e307", "1.7976931348623157e308", "1.7976931348623158e308",
+	"1.7976931348623159e308", "1e308", "1e309", "-1e400", "2.2250738585072014e-308",
+	"2.2250738585072011e-308", "4.9406564584124654e-324", "2.4703282292062327e-324",
+	"2.4703282292062328e-324", "1e-324", "1e-400", "3.4028234663852886e38",
+	"3.4028235677973366e38", "3.4028236e38", "1.17549435e-38", "1.4e-45", "7e-46",
+	"9007199254740993", "9007199254740992.5", "9007199254740993.000000000000000001",
+	"123456789012345678901234567890", "0.000000000000000000000000000001234",
+	"1234567890123456789", "12345678901234567890", "99999999999999999999",
+	"7.2057594037927933e16", "4.35679153e-9", "1.00000005960464477550",
+	"1.0000000596046447755", "179769313486231580793728971405303415079934132710037826936173778980444968292764750946649017977587207096330286416692887910946555547851940402630657488671505820681908902000708383676273854845817711531764475730270069855571366959622842914819860834936475292719074168444365510704342711559699508093042880177904174497791.9999999999999999999999999999999999999999999999999999999999999999999999",
+	"inf", "-inf", "INF", "Infinity", "-InFiNiTy", "nan", "-nan", "NaN",
+	"1e", "1e+", "e5", ".", "-", "+", "1.2.3", "0x10", "1,5", " 1", "1 ",
+	"infinit", "nana", "1e5x", "--1", "1_000", "1e-", "0.5e+1", "5E-1",
+	0
+};
+
+static uint64_t rngState = UINT64_C(0x9E3779B97F4A7C15);
+
+static uint64_t rng(void) {
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 7;
+	rngState ^= rngState << 17;
+	return rngState;
+}
+
+static int failures = 0;
+
+static void check(const xoptContext *ctx, const char *str) {
+	FloatConfig config;
+	xoptResult res;
+	const char *argv[2];
+	char arg[1024];
+	char *end;
+	double expectD;
+	float expectF;
+	bool ok, valid, range;
+
+	argv[0] = "float-test";
+	argv[1] = arg;
+
+	expectD = strtod(str, &end);
+	valid = *str && end == str + strlen(str) && !strchr(str, 'x')
+		&& !strchr(str, 'X') && !strchr(str, '(') && *str != ' ';
+
+	/* double */
+	sprintf(arg, "--double=%s", str);
+	config.d = 0;
+	ok = xopt_parse_r(ctx, 2, argv, &config, &res);
+	range = !isinf(expectD) || strchr(str, 'i') || strchr(str, 'I');
+	if (valid && range) {
+		if (!ok || memcmp(&config.d, &expectD, sizeof(double))) {
+			if (!(isnan(expectD) && isnan(config.d))) {
+				printf("FAIL double '%s': got %.17g, expected %.17g\n", str,
+						config.d, expectD);
+				++failures;
+			}
+		}
+	} else if (ok) {
+		printf("FAIL double '%s': accepted as %.17g\n", str, config.d);
+		++failures;
+	} else if (valid && res.error.code != XOPT_ERR_RANGE) {
+		printf("FAIL double '%s': expected a range error\n", str);
+		++failures;
+	}
+	xopt_result_free(&res);
+
+	/* float */
+	expectF = strtof(str, &end);
+	sprintf(arg, "--float=%s", str);
+	config.f = 0;
+	ok = xopt_parse_r(ctx, 2, argv, &config, &res);
+	range = !isinf(expectF) || strchr(str, 'i') || strchr(str, 'I');
+	if (valid && range) {
+		if (!ok || memcmp(&config.f, &expectF, sizeof(float))) {
+			if (!(isnan(expectF) && isnan(config.f))) {
+				printf("FAIL float '%s': got %.9g, expected %.9g\n", str,
+						(double) config.f, (double) expectF);
+				++failures;
+			}
+		}
+	} else if (ok) {
+		printf("FAIL float '%s': accepted as %.9g\n", str, (double) config.f);
+		++failures;
+	} else if (valid && res.error.code != XOPT_ERR_RANGE) {
+		printf("FAIL float '%s': expected a range error\n", str);
+		++failures;
+	}
+	xopt_result_free(&res);
+}
+
+static void randomCase(char *buf, size_t size) {
+	uint64_t bits = rng();
+	long double lo, hi;
+	double x, y;
+	int digits, i, n;
+
+	switch (rng() % 5) {
+	case 0: /* random bit patterns, shortest round trip */
+		memcpy(&x, &bits, sizeof(x));
+		if (isnan(x) || isinf(x)) {
+			x = 1.0;
+		}
+		sprintf(buf, "%.17g", x);
+		break;
+	case 1: /* random floats */
+		x = (double) (float) ((bits % 1000000) * pow(10, (int) (rng() % 90) - 50));
+		sprintf(buf, "%.9g", x);
+		break;
+	case 2: /* halfway between two doubles, to some number of digits */
+		bits &= UINT64_C(0x7FEFFFFFFFFFFFFF);
+		memcpy(&x, &bits, sizeof(x));
+		++bits;
+		memcpy(&y, &bits, sizeof(y));
+		lo = x;
+		hi = y;
+		sprintf(buf, "%.*Le", (int) (rng() % 60) + 15, (lo + hi) / 2);
+		break;
+	case 3: /* halfway between two floats */
+		bits = (bits & 0x7F7FFFFF) | 0x00800000;
+		{
+			uint32_t b32 = (uint32_t) bits;
+			float fx, fy;
+			memcpy(&fx, &b32, sizeof(fx));
+			++b32;
+			memcpy(&fy, &b32, sizeof(fy));
+			sprintf(buf, "%.*e", (int) (rng() % 30) + 6,
+					((double) fx + (double) fy) / 2);
+		}
+		break;
+	default: /* random digit strings */
+		digits = (int) (rng() % 40) + 1;
+		n = 0;
+		for (i = 0; i < digits; i++) {
+			buf[n++] = (char) ('0' + rng() % 10);
+			if (i == (int) (rng() % digits)) {
+				buf[n++] = '.';
+			}
+		}
+		sprintf(buf + n, "e%d", (int) (rng() % 700) - 350);
+		break;
+	}
+
+	(void) size;
+}
+
+int main(void) {
+	int result = 0;
+	const char *err = 0;
+	xoptContext *ctx;
+	FloatConfig config;
+	xoptResult res;
+	const char **argv;
+	char *values;
+	char buf[256];
+	double sink = 0;
+	clock_t start;
+	double xoptMs, strtodMs;
+	long i;
+	int round;
+
+	ctx = xopt_context("float-test", options, XOPT_CTX_STRICT, &err);
+	if (err) {
+		fprintf(stderr, "Error: %s\n", err);
+		return 1;
+	}
+
+	for (i = 0; edgeCases[i]; i++) {
+		check(ctx, edgeCases[i]);
+	}
+
+	for (i = 0; i < RANDOM_CASES; i++) {
+		randomCase(buf, sizeof(buf));
+		check(ctx, buf);
+	}
+
+	/* a comma decimal separator mustn't change anything */
+	if (setlocale(LC_NUMERIC, "de_DE.UTF-8")
+			|| setlocale(LC_NUMERIC, "fr_FR.UTF-8")) {
+		argv = malloc(sizeof(*argv) * 3);
+		argv[0] = "float-test";
+		argv[1] = "-d";
+		argv[2] = "1.5";
+		if (!xopt_parse_r(ctx, 3, argv, &config, &res) || config.d != 1.5) {
+			printf("FAIL: '1.5' depends on the locale\n");
+			++failures;
+		}
+		xopt_result_free(&res);
+		free(argv);
+		setlocale(LC_NUMERIC, "C");
+	}
+
+	printf("%d failures\n", failures);
+	if (failures) {
+		result = 2;
+	}
+
+	/* throughput: the same values through xopt and through strtod */
+	argv = malloc(sizeof(*argv) * (BENCH_VALUES * 2 + 1));
+	values = malloc(BENCH_VALUES * 32);
+	if (!argv || !values) {
+		fprintf(stderr, "Error: could not allocate benchmark values\n");
+		free(argv);
+		free(values);
+		xopt_context_free(ctx);
+		return 1;
+	}
+
+	argv[0] = "float-test";
+	for (i = 0; i < BENCH_VALUES; i++) {
+		double x;
+		uint64_t bits = rng() & UINT64_C(0x3FFFFFFFFFFFFFFF);
+		memcpy(&x, &bits, sizeof(x));
+		sprintf(values + i * 32, "%.17g", x);
+		argv[i * 2 + 1] = "-d";
+		argv[i * 2 + 2] = values + i * 32;
+	}
+
+	start = clock();
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		if (!xopt_parse_r(ctx, BENCH_VALUES * 2 + 1, argv, &config, &res)) {
+			fprintf(stderr, "Error: %s\n",
+					xopt_strerror(&res.error, buf, sizeof(buf)));
+			result = 3;
+		}
+		sink += config.d;
+		xopt_result_free(&res);
+	}
+	xoptMs = (double) (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+	start = clock();
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		for (i = 0; i < BENCH_VALUES; i++) {
+			sink += strtod(values + i * 32, 0);
+		}
+	}
+	strtodMs = (double) (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+	printf("%10s %12s %12s\n", "", "total ms", "ns/value");
+	printf("%10s %12.3f %12.2f\n", "xopt", xoptMs,
+			xoptMs * 1000000.0 / (BENCH_VALUES * BENCH_ROUNDS));
+	printf("%10s %12.3f %12.2f\n", "strtod", strtodMs,
+			strtodMs * 1000000.0 / (BENCH_VALUES * BENCH_ROUNDS));
+
+	if (sink == 0.5) {
+		printf("\n");
+	}
+
+	free(values);
+	free(argv);
+	xopt_context_free(ctx);
+	return result;
+}
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../xopt.h"
+
+/*
+	Checks the help text (rendered, wrapped and cached), xopt_search() and
+	xopt_complete(). The help is compared against golden copies; search
+	results are compared against a plain scan of every option's fields, for
+	every keyword cut out of them.
+*/
+
+/* six and four double width characters, and one with a combining accent */
+#define WIDE6 "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE\xE3\x82\xBF" \
+	"\xE3\x82\xA4"
+#define WIDE4 "\xE3\x83\x88\xE3\x83\xAB\xE3\x81\xA7\xE3\x81\x99"
+#define CAFE "(cafe\xCC\x81)"
+
+typedef struct {
+	const char *name;
+	bool color;
+	int level;
+	const char *title;
+	const char *output;
+} HelpConfig;
+
+xoptChoice levels[] = {
+	{"debug", 0},
+	{"info", 1},
+	{"warn", 2},
+	{"warning", 3},
+	XOPT_NULLCHOICE
+};
+
+xoptOption options[] = {
+	{
+		"name",
+		'n',
+		offsetof(HelpConfig, name),
+		0,
+		XOPT_TYPE_STRING,
+		"name",
+		"The name to greet, which is looked up in the address book first",
+		0
+	},
+	{
+		"color",
+		'c',
+		offsetof(HelpConfig, color),
+		0,
+		XOPT_TYPE_BOOL,
+		0,
+		"Colored output",
+		0
+	},
+	{
+		"level",
+		'l',
+		offsetof(HelpConfig, level),
+		0,
+		XOPT_TYPE_ENUM,
+		"level",
+		"Log level: debug, info or warn",
+		levels
+	},
+	{
+		"title",
+		0,
+		offsetof(HelpConfig, title),
+		0,
+		XOPT_TYPE_STRING,
+		"text",
+		WIDE6 WIDE4 " " CAFE,
+		0
+	},
+	{
+		"output-directory-for-reports",
+		'o',
+		offsetof(HelpConfig, output),
+		0,
+		XOPT_TYPE_STRING,
+		"dir",
+		"Where to write",
+		0
+	},
+	XOPT_NULLOPTION
+};
+
+/* the options as xopt_autohelp() prints them, and wrapped to 40 columns
+	 (which pulls the descriptions in to half of that), to 64 (which pulls
+	 them in just far enough to leave them 30 columns) and to 24 */
+static const char unwrapped[] =
+	"-n, --name=name                         The name to greet, which is looked "
+		"up in the address book first\n"
+	"-c, --color                             Colored output\n"
+	"-l, --level=level                       Log level: debug, info or warn\n"
+	"--title=text                            " WIDE6 WIDE4 " " CAFE "\n"
+	"-o, --output-directory-for-reports=dir  Where to write\n";
+
+static const char wrapped40[] =
+	"-n, --name=name     The name to greet,\n"
+	"                    which is looked up\n"
+	"                    in the address book\n"
+	"                    first\n"
+	"-c, --color         Colored output\n"
+	"-l, --level=level   Log level: debug,\n"
+	"                    info or warn\n"
+	"--title=text        " WIDE6 WIDE4 "\n"
+	"                    " CAFE "\n"
+	"-o, --output-directory-for-reports=dir\n"
+	"                    Where to write\n";
+
+static const char wrapped64[] =
+	"-n, --name=name                   The name to greet, which is\n"
+	"                                  looked up in the address book\n"
+	"                                  first\n"
+	"-c, --color                       Colored output\n"
+	"-l, --level=level                 Log level: debug, info or warn\n"
+	"--title=text                      " WIDE6 WIDE4 " " CAFE "\n"
+	"-o, --output-directory-for-reports=dir\n"
+	"                                  Where to write\n";
+
+static const char usage24[] =
+	"Usage: help-test\n"
+	"[options] <file>...\n"
+	"\n"
+	"Greets.\n"
+	"\n"
+	"-n, --name=name\n"
+	"            The name to\n"
+	"            greet, which\n"
+	"            is looked up\n"
+	"            in the\n"
+	"            address book\n"
+	"            first\n"
+	"-c, --color\n"
+	"            Colored\n"
+	"            output\n"
+	"-l, --level=level\n"
+	"            Log level:\n"
+	"            debug, info\n"
+	"            or warn\n"
+	"--title=text\n"
+	"            " WIDE6 "\n"
+	"            " WIDE4 "\n"
+	"            " CAFE "\n"
+	"-o, --output-directory-for-reports=dir\n"
+	"            Where to\n"
+	"            write\n";
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what) {
+	if (!ok) {
+		printf("FAIL %s\n", what);
+		++failures;
+	}
+}
+
+static void expectHelp(const char *text, const char *golden,
+		const char *what) {
+	if (!text || strcmp(text, golden)) {
+		printf("FAIL %s; got:\n%s\n", what, text ? text : "(null)");
+		++failures;
+	}
+}
+
+static void expectPrinted(FILE *stream, const char *golden,
+		const char *what) {
+	/* what was written to `stream' since it was last rewound */
+	char buf[2048];
+	size_t length = (size_t) ftell(stream);
+
+	rewind(stream);
+	length = fread(buf, 1, length < sizeof(buf) ? length : sizeof(buf) - 1,
+			stream);
+	buf[length] = 0;
+	rewind(stream);
+
+	expectHelp(buf, golden, what);
+}
+
+static bool contains(const char *field, const char *keyword) {
+	/* strstr(), ignoring ASCII case */
+	size_t i, length = strlen(keyword);
+
+	for (; field && *field; field++) {
+		for (i = 0; i < length && field[i]; i++) {
+			char a = field[i], b = keyword[i];
+			if ((a >= 'A' && a <= 'Z' ? a - 'A' + 'a' : a)
+					!= (b >= 'A' && b <= 'Z' ? b - 'A' + 'a' : b)) {
+				break;
+			}
+		}
+
+		if (i == length) {
+			return true;
+		}
+	}
+
+	return !length && field;
+}
+
+static void expectSearch(const xoptContext *ctx, const char *keyword) {
+	/* xopt_search() finds what a scan of every field does, in table order */
+	int matches[8], expected[8];
+	size_t found, count = 0, i;
+	const char *err = 0;
+	const xoptOption *o;
+
+	for (o = options; o->longArg || o->shortArg; o++) {
+		if (contains(o->longArg, keyword) || contains(o->argDescrip, keyword)
+				|| contains(o->descrip, keyword)) {
+			expected[count++] = (int) (o - options);
+		}
+	}
+
+	found = xopt_search(ctx, keyword, matches, 8, &err);
+	for (i = 0; i < found && i < count && matches[i] == expected[i]; i++);
+	if (err || found != count || i != count) {
+		printf("FAIL search '%s': %lu matches, expected %lu\n", keyword,
+				(unsigned long) found, (unsigned long) count);
+		++failures;
+	}
+}
+
+static void expectComplete(const xoptContext *ctx, const char *partial,
+		const char *golden) {
+	/* the completions, joined with spaces */
+	const char *matches[8];
+	char buf[256] = "";
+	const char *err = 0;
+	size_t found, i;
+
+	found = xopt_complete(ctx, partial, matches, 8, &err);
+	for (i = 0; i < found && i < 8; i++) {
+		strcat(buf, i ? " " : "");
+		strcat(buf, matches[i]);
+	}
+
+	if (err || strcmp(buf, golden)) {
+		printf("FAIL complete '%s': '%s'\n", partial, buf);
+		++failures;
+	}
+}
+
+int main(void) {
+	const char *err = 0;
+	xoptContext *ctx;
+	xoptAutohelpOptions usage, sameUsage, defaults;
+	const char *text, *again, *other, *matches[1];
+	char buf[2048], copy[64], keyword[8];
+	size_t length, start, n, i;
+	int match, f;
+	const xoptOption *o;
+	const char *fields[3];
+	FILE *stream;
+
+	ctx = xopt_context("help-test", options, XOPT_CTX_STRICT, &err);
+	if (err) {
+		fprintf(stderr, "Error: %s\n", err);
+		return 1;
+	}
+
+	usage.usage = "Usage: help-test [options] <file>...";
+	usage.prefix = "Greets.";
+	usage.suffix = 0;
+	usage.spacer = 2;
+	sameUsage = usage;
+	strcpy(copy, usage.usage);
+	sameUsage.usage = copy;
+	defaults.usage = defaults.prefix = defaults.suffix = 0;
+	defaults.spacer = 2;
+
+	/* rendering, wrapped or not */
+	length = xopt_autohelp_render(ctx, 0, 0, buf, sizeof(buf));
+	expectHelp(buf, unwrapped, "render, unwrapped");
+	expect(length == strlen(unwrapped), "render returns the length");
+	expect(xopt_autohelp_render(ctx, 0, 0, 0, 0) == length,
+			"render measures without a buffer");
+	xopt_autohelp_render(ctx, 0, 0, buf, 10);
+	expect(!strncmp(buf, unwrapped, 9) && !buf[9], "render truncates");
+	xopt_autohelp_render(ctx, 0, 40, buf, sizeof(buf));
+	expectHelp(buf, wrapped40, "render, 40 columns");
+	xopt_autohelp_render(ctx, 0, 64, buf, sizeof(buf));
+	expectHelp(buf, wrapped64, "render, 64 columns");
+	xopt_autohelp_render(ctx, &usage, 24, buf, sizeof(buf));
+	expectHelp(buf, usage24, "render with usage, 24 columns");
+
+	/* the cache: one text per set of options (compared by content), for
+		 the latest columns */
+	text = xopt_autohelp_text(ctx, 0, 40, &length, &err);
+	expectHelp(text, wrapped40, "cached text, 40 columns");
+	expect(!err && length == strlen(wrapped40), "cached text length");
+	again = xopt_autohelp_text(ctx, &defaults, 40, &length, &err);
+	expect(again == text, "the same options and columns share a text");
+	other = xopt_autohelp_text(ctx, &usage, 24, &length, &err);
+	expectHelp(other, usage24, "cached text with usage");
+	again = xopt_autohelp_text(ctx, &sameUsage, 24, &length, &err);
+	expect(again == other, "options are compared by content");
+	again = xopt_autohelp_text(ctx, 0, 40, &length, &err);
+	expect(again == text, "other options don't replace a text");
+	text = xopt_autohelp_text(ctx, 0, 64, &length, &err);
+	expectHelp(text, wrapped64, "cached text, now at 64 columns");
+	text = xopt_autohelp_text(ctx, 0, 40, &length, &err);
+	expectHelp(text, wrapped40, "cached text, back at 40 columns");
+	again = xopt_autohelp_text(ctx, &usage, 24, &length, &err);
+	expect(again == other, "other columns don't replace other options");
+
+	/* printing goes through the same cache */
+	stream = tmpfile();
+	if (stream) {
+		xopt_autohelp(ctx, stream, &defaults, &err);
+		expectPrinted(stream, unwrapped, "xopt_autohelp");
+		xopt_autohelp_wrap(ctx, stream, &usage, 24, &err);
+		expectPrinted(stream, usage24, "xopt_autohelp_wrap");
+		fclose(stream);
+	}
+
+	/* search: every keyword of up to 5 characters cut out of the fields,
+		 as is and uppercased, covers both a plain scan (under 3) and the
+		 trigram index; then ones whose trigrams are all there but not
+		 together, or not at all */
+	for (o = options; o->longArg || o->shortArg; o++) {
+		fields[0] = o->longArg;
+		fields[1] = o->argDescrip;
+		fields[2] = o->descrip;
+		for (f = 0; f < 3; f++) {
+			for (start = 0; fields[f] && fields[f][start]; start++) {
+				for (n = 1; n <= 5 && fields[f][start + n - 1]; n++) {
+					memcpy(keyword, fields[f] + start, n);
+					keyword[n] = 0;
+					expectSearch(ctx, keyword);
+					for (i = 0; i < n; i++) {
+						if (keyword[i] >= 'a' && keyword[i] <= 'z') {
+							keyword[i] = (char) (keyword[i] - 'a' + 'A');
+						}
+					}
+					expectSearch(ctx, keyword);
+				}
+			}
+		}
+	}
+	expectSearch(ctx, "");
+	expectSearch(ctx, "address book");
+	expectSearch(ctx, "dree");
+	expectSearch(ctx, "putp");
+	expectSearch(ctx, "zzz");
+	expectSearch(ctx, "name\nname");
+	expect(xopt_search(ctx, "dree", &match, 1, &err) == 0,
+			"'dree' is only in trigrams");
+	expect(xopt_search(ctx, "o", &match, 1, &err) == 4 && match == 0,
+			"search counts past `max'");
+
+	/* completion, booleans' negations included */
+	expectComplete(ctx, "", "color level name no-color "
+			"output-directory-for-reports title");
+	expectComplete(ctx, "--", "color level name no-color "
+			"output-directory-for-reports title");
+	expectComplete(ctx, "--n", "name no-color");
+	expectComplete(ctx, "no-", "no-color");
+	expectComplete(ctx, "--o", "output-directory-for-reports");
+	expectComplete(ctx, "--x", "");
+	expectComplete(ctx, "--level=", "debug info warn warning");
+	expectComplete(ctx, "--level=warn", "warn warning");
+	expectComplete(ctx, "--level=e", "");
+	expectComplete(ctx, "--name=", "");
+	expectComplete(ctx, "--bogus=x", "");
+	expect(xopt_complete(ctx, "--n", matches, 1, &err) == 2
+			&& !strcmp(matches[0], "name"), "complete counts past `max'");
+
+	printf("%d failures\n", failures);
+	xopt_context_free(ctx);
+	return failures ? 2 : 0;
+}
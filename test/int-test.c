@@ -0,0 +1,405 @@
+#define _ISOC99_SOURCE /* strtoll, strtoull */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "../xopt.h"
+
+/*
+	Differential test of the integer option types against strtoll / strtoull
+	(with a base of 0): every string they accept in full must parse to the
+	same value, or fail with a range error where it doesn't fit the type;
+	every other string must be rejected. Unsigned types take no negative
+	values but -0, where strtoull would wrap around instead.
+*/
+
+#define RANDOM_CASES 200000
+
+typedef struct {
+	int i;
+	long l;
+	int32_t i32;
+	int64_t i64;
+	uint32_t u32;
+	uint64_t u64;
+} IntConfig;
+
+xoptOption options[] = {
+	{
+		"int",
+		'i',
+		offsetof(IntConfig, i),
+		0,
+		XOPT_TYPE_INT,
+		"n",
+		"An int",
+		0
+	},
+	{
+		"long",
+		'l',
+		offsetof(IntConfig, l),
+		0,
+		XOPT_TYPE_LONG,
+		"n",
+		"A long",
+		0
+	},
+	{
+		"int32",
+		0,
+		offsetof(IntConfig, i32),
+		0,
+		XOPT_TYPE_INT32,
+		"n",
+		"An int32_t",
+		0
+	},
+	{
+		"int64",
+		0,
+		offsetof(IntConfig, i64),
+		0,
+		XOPT_TYPE_INT64,
+		"n",
+		"An int64_t",
+		0
+	},
+	{
+		"uint32",
+		0,
+		offsetof(IntConfig, u32),
+		0,
+		XOPT_TYPE_UINT32,
+		"n",
+		"A uint32_t",
+		0
+	},
+	{
+		"uint64",
+		0,
+		offsetof(IntConfig, u64),
+		0,
+		XOPT_TYPE_UINT64,
+		"n",
+		"A uint64_t",
+		0
+	},
+	XOPT_NULLOPTION
+};
+
+/* the limits of each type; minimums are given as magnitudes */
+typedef struct {
+	const char *name;
+	bool isSigned;
+	uint64_t maxPos;
+	uint64_t maxNeg;
+} IntType;
+
+static IntType types[6];
+
+static const char *edgeCases[] = {
+	"0", "-0", "+0", "00", "-00", "1", "-1", "+1", "7", "8", "9", "10", "010",
+	"08", "09", "0x0", "-0x0", "0X0", "0xa", "0XA", "0xF", "0xf", "-0xf", "0x",
+	"0X", "-0x", "0x-1", "0xg", "0x1g", "0b101", "1e3", "1.0", "", "-", "+",
+	"+-1", "-+1", "--1", "++1", " 1", "1 ", "- 1", "\t1", "1_000", "1,000",
+	"12345678", "123456789", "1234567a", "123456789a", "1234567/", "1234567:",
+	"12345678/", "12345678:", "/2345678", ":2345678", "99999999", "100000000",
+	"9999999999999999", "10000000000000000", "18446744073709551615",
+	"18446744073709551616", "-18446744073709551615", "-18446744073709551616",
+	"9223372036854775807", "9223372036854775808", "-9223372036854775808",
+	"-9223372036854775809", "0xFFFFFFFFFFFFFFFF", "0x10000000000000000",
+	"0x00000000000000000000FFFFFFFFFFFFFFFF", "01777777777777777777777",
+	"02000000000000000000000", "-01000000000000000000000",
+	"0000000000000000000000000000000000000000000000000000000000000000001",
+	"4294967295", "4294967296", "2147483647", "2147483648", "-2147483648",
+	"-2147483649", "0xFFFFFFFF", "0x100000000", "037777777777", "040000000000",
+	0
+};
+
+static uint64_t rngState = UINT64_C(0x2545F4914F6CDD1D);
+
+static uint64_t rng(void) {
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 7;
+	rngState ^= rngState << 17;
+	return rngState;
+}
+
+static int failures = 0;
+
+static const char *format(char *buf, const char *sign, const char *prefix,
+		uint64_t value, unsigned base) {
+	/* writes the sign, the prefix and the value's digits (lowercase for hex) */
+	char digits[70], *p = buf;
+	int n = 0;
+
+	do {
+		digits[n++] = "0123456789abcdef"[value % base];
+		value /= base;
+	} while (value);
+
+	sprintf(p, "%s%s", sign, prefix);
+	p += strlen(p);
+	while (n) {
+		*p++ = digits[--n];
+	}
+	*p = 0;
+	return buf;
+}
+
+static int reference(const IntType *type, const char *str, bool *negative,
+		uint64_t *magnitude) {
+	/* what xopt should make of `str', according to strtoll / strtoull */
+	const char *digits = str;
+	char *end;
+	int64_t value;
+
+	/* xopt doesn't get as far as parsing an empty value */
+	if (!*str) {
+		return XOPT_ERR_MISSING_VALUE;
+	}
+
+	if (*digits == '-' || *digits == '+') {
+		++digits;
+	}
+
+	/* strto* skip whitespace and take a sign on their own */
+	if (*digits < '0' || *digits > '9') {
+		return XOPT_ERR_NUMBER;
+	}
+
+	strtoull(str, &end, 0);
+	if (*end) {
+		return XOPT_ERR_NUMBER;
+	}
+
+	*negative = *str == '-';
+	if (type->isSigned) {
+		errno = 0;
+		value = strtoll(str, 0, 0);
+		if (errno == ERANGE) {
+			return XOPT_ERR_RANGE;
+		}
+
+		*magnitude = value < 0 ? (uint64_t) -(value + 1) + 1 : (uint64_t) value;
+	} else {
+		errno = 0;
+		*magnitude = strtoull(digits, 0, 0);
+		if (errno == ERANGE) {
+			return XOPT_ERR_RANGE;
+		}
+	}
+
+	if (*magnitude > (*negative ? type->maxNeg : type->maxPos)) {
+		return XOPT_ERR_RANGE;
+	}
+
+	return XOPT_ERR_NONE;
+}
+
+static void stored(const IntConfig *config, int t, bool *negative,
+		uint64_t *magnitude) {
+	int64_t value;
+
+	switch (t) {
+	case 0:
+		value = config->i;
+		break;
+	case 1:
+		value = config->l;
+		break;
+	case 2:
+		value = config->i32;
+		break;
+	case 3:
+		value = config->i64;
+		break;
+	case 4:
+		*negative = false;
+		*magnitude = config->u32;
+		return;
+	default:
+		*negative = false;
+		*magnitude = config->u64;
+		return;
+	}
+
+	*negative = value < 0;
+	*magnitude = value < 0 ? (uint64_t) -(value + 1) + 1 : (uint64_t) value;
+}
+
+static void check(const xoptContext *ctx, const char *str) {
+	IntConfig config;
+	xoptResult res;
+	const char *argv[2];
+	char arg[512], got[32], expected[32];
+	bool ok, negative, expectNegative = false, gotNegative;
+	uint64_t magnitude, expectMagnitude = 0;
+	int t, code;
+
+	argv[0] = "int-test";
+	argv[1] = arg;
+
+	for (t = 0; t < 6; t++) {
+		code = reference(&types[t], str, &expectNegative, &expectMagnitude);
+		/* unsigned types keep no sign, so -0 is plain 0 */
+		negative = expectNegative && expectMagnitude;
+
+		sprintf(arg, "--%s=%s", types[t].name, str);
+		memset(&config, 0, sizeof(config));
+		ok = xopt_parse_r(ctx, 2, argv, &config, &res);
+		stored(&config, t, &gotNegative, &magnitude);
+
+		if (!code) {
+			if (!ok || gotNegative != negative || magnitude != expectMagnitude) {
+				printf("FAIL %s '%s': got %s (%s), expected %s\n", types[t].name,
+						str, format(got, gotNegative ? "-" : "", "", magnitude, 10),
+						ok ? "ok" : "failed",
+						format(expected, negative ? "-" : "", "", expectMagnitude, 10));
+				++failures;
+			}
+		} else if (ok) {
+			printf("FAIL %s '%s': accepted as %s\n", types[t].name, str,
+					format(got, gotNegative ? "-" : "", "", magnitude, 10));
+			++failures;
+		} else if (res.error.code != code) {
+			printf("FAIL %s '%s': expected a %s error\n", types[t].name, str,
+					code == XOPT_ERR_RANGE ? "range"
+					: code == XOPT_ERR_NUMBER ? "number" : "missing value");
+			++failures;
+		}
+		xopt_result_free(&res);
+	}
+}
+
+static void checkBoundaries(const xoptContext *ctx, const IntType *type) {
+	/* one either side of each limit, in every base */
+	static const char *signs[] = {"", "+", "-"};
+	static const char *prefixes[] = {"", "0x", "0X", "0"};
+	static const unsigned bases[] = {10, 16, 16, 8};
+	uint64_t limits[2], value;
+	char buf[128];
+	int limit, delta, s, b;
+
+	limits[0] = type->maxPos;
+	limits[1] = type->maxNeg;
+	for (limit = 0; limit < 2; limit++) {
+		for (delta = -1; delta <= 1; delta++) {
+			value = limits[limit] + delta;
+			if ((delta < 0 && !limits[limit]) || (delta > 0 && !~limits[limit])) {
+				continue;
+			}
+
+			for (s = 0; s < 3; s++) {
+				for (b = 0; b < 4; b++) {
+					check(ctx, format(buf, signs[s], prefixes[b], value, bases[b]));
+				}
+			}
+		}
+	}
+}
+
+static void randomCase(char *buf) {
+	/* numbers of every length in every base, some of them long enough to take
+		 the SWAR path a few times over or overflowing, some of them broken */
+	static const char noise[] = "0189afAFxX+-/: ";
+	const char *sign = rng() % 4 ? "" : "-";
+	uint64_t value;
+	int digits, i, n;
+
+	switch (rng() % 4) {
+	case 0: /* random values */
+		value = rng() >> (rng() % 64);
+		format(buf, sign, "", value, 10);
+		break;
+	case 1: /* hex and octal */
+		value = rng() >> (rng() % 64);
+		if (rng() % 2) {
+			format(buf, sign, rng() % 2 ? "0x" : "0X", value, 16);
+		} else {
+			format(buf, sign, "0", value, 8);
+		}
+		break;
+	case 2: /* long digit strings */
+		digits = (int) (rng() % 64) + 1;
+		n = 0;
+		if (rng() % 4 == 0) {
+			buf[n++] = rng() % 2 ? '-' : '+';
+		}
+		buf[n++] = (char) ('1' + rng() % 9);
+		for (i = 1; i < digits; i++) {
+			buf[n++] = (char) ('0' + rng() % 10);
+		}
+		buf[n] = 0;
+		break;
+	default: /* broken ones */
+		format(buf, sign, "", rng(), 10);
+		n = (int) strlen(buf);
+		buf[rng() % n] = noise[rng() % (sizeof(noise) - 1)];
+		break;
+	}
+}
+
+int main(void) {
+	int result = 0;
+	const char *err = 0;
+	xoptContext *ctx;
+	char buf[256];
+	long i;
+	int t;
+
+	types[0].name = "int";
+	types[0].maxPos = INT_MAX;
+	types[0].maxNeg = (uint64_t) -(INT_MIN + 1) + 1;
+	types[1].name = "long";
+	types[1].maxPos = LONG_MAX;
+	types[1].maxNeg = (uint64_t) -(LONG_MIN + 1) + 1;
+	types[2].name = "int32";
+	types[2].maxPos = INT32_MAX;
+	types[2].maxNeg = (uint64_t) INT32_MAX + 1;
+	types[3].name = "int64";
+	types[3].maxPos = INT64_MAX;
+	types[3].maxNeg = (uint64_t) INT64_MAX + 1;
+	types[4].name = "uint32";
+	types[4].maxPos = UINT32_MAX;
+	types[4].maxNeg = 0;
+	types[5].name = "uint64";
+	types[5].maxPos = UINT64_MAX;
+	types[5].maxNeg = 0;
+	for (t = 0; t < 6; t++) {
+		types[t].isSigned = t < 4;
+	}
+
+	ctx = xopt_context("int-test", options, XOPT_CTX_STRICT, &err);
+	if (err) {
+		fprintf(stderr, "Error: %s\n", err);
+		return 1;
+	}
+
+	for (i = 0; edgeCases[i]; i++) {
+		check(ctx, edgeCases[i]);
+	}
+
+	for (t = 0; t < 6; t++) {
+		checkBoundaries(ctx, &types[t]);
+	}
+
+	for (i = 0; i < RANDOM_CASES; i++) {
+		randomCase(buf);
+		check(ctx, buf);
+	}
+
+	printf("%d failures\n", failures);
+	if (failures) {
+		result = 2;
+	}
+
+	xopt_context_free(ctx);
+	return result;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../xopt.h"
+
+/*
+	Checks that values living in a parse's memory (list spans and maps)
+	are only handed out by a parse that succeeds: a failing parse frees that
+	memory, so it must leave the caller's fields alone. Build with
+	-fsanitize=address to catch any dangling pointer being read.
+*/
+
+typedef struct {
+	xoptInt32List shards;
+	xoptDoubleList weights;
+	xoptMap *defs;
+	int num;
+} ResultConfig;
+
+xoptOption options[] = {
+	{
+		"shards",
+		's',
+		offsetof(ResultConfig, shards),
+		0,
+		XOPT_TYPE_INT32_LIST,
+		"n,...",
+		"Shard numbers",
+		0
+	},
+	{
+		"weights",
+		'w',
+		offsetof(ResultConfig, weights),
+		0,
+		XOPT_TYPE_DOUBLE_LIST | XOPT_REPEAT,
+		"x,...",
+		"Weights (repeatable)",
+		0
+	},
+	{
+		"define",
+		'D',
+		offsetof(ResultConfig, defs),
+		0,
+		XOPT_TYPE_MAP,
+		"key=value",
+		"Defines a key",
+		0
+	},
+	{
+		"num",
+		'n',
+		offsetof(ResultConfig, num),
+		0,
+		XOPT_TYPE_INT,
+		"n",
+		"A number",
+		0
+	},
+	XOPT_NULLOPTION
+};
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what) {
+	if (!ok) {
+		printf("FAIL %s\n", what);
+		++failures;
+	}
+}
+
+int main(void) {
+	const char *err = 0;
+	xoptContext *ctx;
+	ResultConfig config;
+	xoptResult res;
+	bool ok;
+
+	const char *failing[] = {"result-test", "--shards=1,2,3", "-w", "0.5",
+		"-D", "a=1", "--num=2147483648"};
+	const char *lastWins[] = {"result-test", "--shards=1,2", "-s", "4,5,6",
+		"-w", "1,2", "-w", "3", "-D", "a=1", "-D", "b=2", "-n", "7"};
+	const char *emptyKey[] = {"result-test", "-D", "a=1", "-D", "=2"};
+
+	ctx = xopt_context("result-test", options, XOPT_CTX_STRICT, &err);
+	if (err) {
+		fprintf(stderr, "Error: %s\n", err);
+		return 1;
+	}
+
+	/* a failing parse hands nothing out */
+	memset(&config, 0, sizeof(config));
+	ok = xopt_parse_r(ctx, 7, failing, &config, &res);
+	expect(!ok && res.error.code == XOPT_ERR_RANGE, "--num overflow fails");
+	expect(!config.shards.items && !config.shards.count,
+			"failed parse leaves a list unset");
+	expect(!config.weights.items && !config.weights.count,
+			"failed parse leaves a repeated list unset");
+	expect(!config.defs, "failed parse leaves a map unset");
+	xopt_result_free(&res);
+
+	/* as does one with a map entry that has no key */
+	ok = xopt_parse_r(ctx, 5, emptyKey, &config, &res);
+	expect(!ok && res.error.code == XOPT_ERR_VALUE && res.error.argi == 4,
+			"-D =2 fails");
+	expect(!config.defs, "an empty key leaves the map unset");
+	xopt_result_free(&res);
+
+	/* a succeeding one hands out the last list, every repeated value and
+		 the map */
+	ok = xopt_parse_r(ctx, 14, lastWins, &config, &res);
+	expect(ok, "valid lists parse");
+	expect(config.shards.count == 3 && config.shards.items[0] == 4
+			&& config.shards.items[2] == 6, "the last list wins");
+	expect(config.weights.count == 3 && config.weights.items[0] == 1
+			&& config.weights.items[2] == 3, "repeated lists accumulate");
+	expect(xopt_map_count(config.defs) == 2
+			&& !strcmp(xopt_map_get(config.defs, "b"), "2"), "the map is set");
+	expect(config.num == 7, "--num is set");
+	xopt_result_free(&res);
+
+	printf("%d failures\n", failures);
+	xopt_context_free(ctx);
+	return failures ? 2 : 0;
+}
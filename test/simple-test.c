@@ -19,7 +19,8 @@ xoptOption options[] = {
 		0,
 		XOPT_TYPE_INT,
 		"n",
-		"Some integer value. Can set to whatever number you like."
+		"Some integer value. Can set to whatever number you like.",
+		0
 	},
 	{
 		"some-float",
@@ -28,7 +29,8 @@ xoptOption options[] = {
 		0,
 		XOPT_TYPE_FLOAT,
 		"n",
-		"Some float value."
+		"Some float value.",
+		0
 	},
 	{
 		"some-double",
@@ -37,7 +39,8 @@ xoptOption options[] = {
 		0,
 		XOPT_TYPE_DOUBLE,
 		"n",
-		"Some double value."
+		"Some double value.",
+		0
 	},
 	{
 		"help",
@@ -46,7 +49,8 @@ xoptOption options[] = {
 		0,
 		XOPT_TYPE_BOOL,
 		0,
-		"Shows this help message"
+		"Shows this help message",
+		0
 	},
 	XOPT_NULLOPTION
 };
@@ -116,7 +120,7 @@ int main(int argc, const char **argv) {
 #undef P
 
 exit:
-	if (extras) free(extras); /* DO NOT free individual strings */
-	if (ctx) free(ctx);       /*   they point to argv strings   */
+	if (extras) free(extras);        /* DO NOT free individual strings */
+	if (ctx) xopt_context_free(ctx); /*   they point to argv strings   */
 	return result;
 }
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../xopt.h"
+
+/*
+	Checks the option types that go beyond plain numbers and strings: enums
+	(both through the perfect hash and the linear scan it falls back to when
+	names' full hashes collide), flags, sizes, durations, counters and
+	--no-<name>, along with the errors each of them reports.
+*/
+
+typedef struct {
+	int level;
+	int word;
+	uint64_t features[2];
+	uint64_t size;
+	uint64_t timeout;
+	int verbose;
+	bool color;
+	int num;
+} TypesConfig;
+
+xoptChoice levels[] = {
+	{"debug", 0},
+	{"info", 1},
+	{"warn", 2},
+	{"error", 3},
+	XOPT_NULLCHOICE
+};
+
+/* pairs of names with the same (32-bit FNV-1a) hash, which no displacement
+	 can tell apart */
+xoptChoice words[] = {
+	{"costarring", 1},
+	{"liquid", 2},
+	{"declinate", 3},
+	{"macallums", 4},
+	XOPT_NULLCHOICE
+};
+
+xoptChoice features[] = {
+	{"a", 0},
+	{"b", 1},
+	{"top", 63},
+	{"high", 64},
+	XOPT_NULLCHOICE
+};
+
+xoptOption options[] = {
+	{
+		"level",
+		'l',
+		offsetof(TypesConfig, level),
+		0,
+		XOPT_TYPE_ENUM,
+		"level",
+		"Log level",
+		levels
+	},
+	{
+		"word",
+		0,
+		offsetof(TypesConfig, word),
+		0,
+		XOPT_TYPE_ENUM,
+		"word",
+		"A word",
+		words
+	},
+	{
+		"features",
+		'f',
+		offsetof(TypesConfig, features),
+		0,
+		XOPT_TYPE_FLAGS,
+		"name,...",
+		"Features to turn on (or off, with -)",
+		features
+	},
+	{
+		"size",
+		's',
+		offsetof(TypesConfig, size),
+		0,
+		XOPT_TYPE_SIZE,
+		"bytes",
+		"A size",
+		0
+	},
+	{
+		"timeout",
+		't',
+		offsetof(TypesConfig, timeout),
+		0,
+		XOPT_TYPE_DURATION,
+		"duration",
+		"A timeout",
+		0
+	},
+	{
+		"verbose",
+		'v',
+		offsetof(TypesConfig, verbose),
+		0,
+		XOPT_TYPE_COUNTER,
+		0,
+		"More output (repeatable)",
+		0
+	},
+	{
+		"color",
+		'c',
+		offsetof(TypesConfig, color),
+		0,
+		XOPT_TYPE_BOOL,
+		0,
+		"Colored output",
+		0
+	},
+	{
+		"num",
+		'n',
+		offsetof(TypesConfig, num),
+		0,
+		XOPT_TYPE_INT,
+		"n",
+		"A number",
+		0
+	},
+	XOPT_NULLOPTION
+};
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what) {
+	if (!ok) {
+		printf("FAIL %s\n", what);
+		++failures;
+	}
+}
+
+static bool parse(const xoptContext *ctx, const char *arg, TypesConfig *config,
+		xoptResult *res) {
+	/* parses a lone argument into a fresh config */
+	const char *argv[2];
+
+	argv[0] = "types-test";
+	argv[1] = arg;
+	memset(config, 0, sizeof(*config));
+	return xopt_parse_r(ctx, 2, argv, config, res);
+}
+
+static void expectValue(const xoptContext *ctx, const char *arg,
+		size_t offset, uint64_t value) {
+	/* `arg' parses, leaving `value' in the uint64_t at `offset' */
+	TypesConfig config;
+	xoptResult res;
+	bool ok = parse(ctx, arg, &config, &res);
+
+	if (!ok || *(uint64_t*) ((char*) &config + offset) != value) {
+		printf("FAIL %s: %s\n", arg, ok ? "wrong value" : "failed");
+		++failures;
+	}
+	xopt_result_free(&res);
+}
+
+static void expectError(const xoptContext *ctx, const char *arg, int code,
+		const char *message) {
+	/* `arg' fails with `code' and, if given, `message' */
+	TypesConfig config;
+	xoptResult res;
+	char buf[256];
+	bool ok = parse(ctx, arg, &config, &res);
+
+	if (ok || res.error.code != code || res.error.argi != 1) {
+		printf("FAIL %s: expected error %d, got %d\n", arg, code,
+				ok ? XOPT_ERR_NONE : res.error.code);
+		++failures;
+	} else if (message
+			&& strcmp(xopt_strerror(&res.error, buf, sizeof(buf)), message)) {
+		printf("FAIL %s: message '%s'\n", arg, buf);
+		++failures;
+	}
+	xopt_result_free(&res);
+}
+
+int main(void) {
+	const char *err = 0;
+	xoptContext *ctx;
+	TypesConfig config;
+	xoptResult res;
+	bool ok;
+
+	const char *counted[] = {"types-test", "-vvv"};
+	const char *separate[] = {"types-test", "-v", "-v", "--verbose"};
+	const char *mixed[] = {"types-test", "-cvv", "--no-color", "-v"};
+	const char *flagged[] = {"types-test", "-f", "a,top,high",
+		"--features=-top,+b"};
+
+	ctx = xopt_context("types-test", options, XOPT_CTX_STRICT, &err);
+	if (err) {
+		fprintf(stderr, "Error: %s\n", err);
+		return 1;
+	}
+
+	/* enums, hashed and scanned */
+	ok = parse(ctx, "--level=warn", &config, &res);
+	expect(ok && config.level == 2, "--level=warn");
+	xopt_result_free(&res);
+	ok = parse(ctx, "--word=liquid", &config, &res);
+	expect(ok && config.word == 2, "--word=liquid");
+	xopt_result_free(&res);
+	ok = parse(ctx, "--word=costarring", &config, &res);
+	expect(ok && config.word == 1, "--word=costarring");
+	xopt_result_free(&res);
+	ok = parse(ctx, "--word=macallums", &config, &res);
+	expect(ok && config.word == 4, "--word=macallums");
+	xopt_result_free(&res);
+	expectError(ctx, "--level=loud", XOPT_ERR_CHOICE,
+			"invalid choice: --level=loud (expected debug, info, warn, error)");
+	expectError(ctx, "--level=war", XOPT_ERR_CHOICE, 0);
+	expectError(ctx, "--word=liquids", XOPT_ERR_CHOICE,
+			"invalid choice: --word=liquids (expected costarring, liquid, "
+			"declinate, macallums)");
+	expectError(ctx, "--level=", XOPT_ERR_MISSING_VALUE, 0);
+
+	/* flags, applied in order on top of each other, past the first word */
+	ok = xopt_parse_r(ctx, 4, flagged, &config, &res);
+	expect(ok && config.features[0] == 3 && config.features[1] == 1,
+			"-f a,top,high --features=-top,+b");
+	xopt_result_free(&res);
+	expectValue(ctx, "--features=top", offsetof(TypesConfig, features),
+			UINT64_C(1) << 63);
+	expectError(ctx, "--features=a,bogus,b", XOPT_ERR_CHOICE,
+			"invalid choice: --features=bogus (expected a, b, top, high)");
+	expectError(ctx, "--features=a,", XOPT_ERR_CHOICE, 0);
+	expectError(ctx, "--features=-", XOPT_ERR_CHOICE, 0);
+
+	/* sizes: SI prefixes are powers of 1000, IEC ones of 1024 */
+	expectValue(ctx, "--size=512", offsetof(TypesConfig, size), 512);
+	expectValue(ctx, "--size=10k", offsetof(TypesConfig, size), 10000);
+	expectValue(ctx, "--size=10K", offsetof(TypesConfig, size), 10000);
+	expectValue(ctx, "--size=10KiB", offsetof(TypesConfig, size), 10240);
+	expectValue(ctx, "--size=3MiB", offsetof(TypesConfig, size),
+			UINT64_C(3145728));
+	expectValue(ctx, "--size=2GB", offsetof(TypesConfig, size),
+			UINT64_C(2000000000));
+	expectValue(ctx, "--size=18E", offsetof(TypesConfig, size),
+			UINT64_C(18000000000000000000));
+	expectValue(ctx, "--size=15EiB", offsetof(TypesConfig, size),
+			UINT64_C(15) << 60);
+	expectValue(ctx, "--size=18446744073709551615B",
+			offsetof(TypesConfig, size), UINT64_MAX);
+	expectError(ctx, "--size=18446744073709551616", XOPT_ERR_RANGE, 0);
+	expectError(ctx, "--size=19E", XOPT_ERR_RANGE, 0);
+	expectError(ctx, "--size=16Ei", XOPT_ERR_RANGE, 0);
+	expectError(ctx, "--size=10x", XOPT_ERR_NUMBER, 0);
+	expectError(ctx, "--size=10iB", XOPT_ERR_NUMBER, 0);
+	expectError(ctx, "--size=10BB", XOPT_ERR_NUMBER, 0);
+	expectError(ctx, "--size=-1", XOPT_ERR_NUMBER, 0);
+	expectError(ctx, "--size=k", XOPT_ERR_NUMBER, 0);
+
+	/* durations, in nanoseconds */
+	expectValue(ctx, "--timeout=0", offsetof(TypesConfig, timeout), 0);
+	expectValue(ctx, "--timeout=1h30m", offsetof(TypesConfig, timeout),
+			UINT64_C(5400000000000));
+	expectValue(ctx, "--timeout=1m30s500ms", offsetof(TypesConfig, timeout),
+			UINT64_C(90500000000));
+	expectValue(ctx, "--timeout=5us", offsetof(TypesConfig, timeout), 5000);
+	expectValue(ctx, "--timeout=5\xC2\xB5s", offsetof(TypesConfig, timeout),
+			5000);
+	expectValue(ctx, "--timeout=7ns", offsetof(TypesConfig, timeout), 7);
+	expectValue(ctx, "--timeout=5124095h", offsetof(TypesConfig, timeout),
+			UINT64_C(18446742000000000000));
+	expectError(ctx, "--timeout=1m30", XOPT_ERR_NUMBER, 0);
+	expectError(ctx, "--timeout=30", XOPT_ERR_NUMBER, 0);
+	expectError(ctx, "--timeout=1d", XOPT_ERR_NUMBER, 0);
+	expectError(ctx, "--timeout=h", XOPT_ERR_NUMBER, 0);
+	expectError(ctx, "--timeout=5124096h", XOPT_ERR_RANGE, 0);
+	expectError(ctx, "--timeout=5124095h1h", XOPT_ERR_RANGE, 0);
+	expectError(ctx, "--timeout=18446744073709551616ns", XOPT_ERR_RANGE, 0);
+
+	/* counters count every occurrence, condensed or not */
+	memset(&config, 0, sizeof(config));
+	ok = xopt_parse_r(ctx, 2, counted, &config, &res);
+	expect(ok && config.verbose == 3, "-vvv counts 3");
+	xopt_result_free(&res);
+	memset(&config, 0, sizeof(config));
+	ok = xopt_parse_r(ctx, 4, separate, &config, &res);
+	expect(ok && config.verbose == 3, "-v -v --verbose counts 3");
+	xopt_result_free(&res);
+	memset(&config, 0, sizeof(config));
+	ok = xopt_parse_r(ctx, 4, mixed, &config, &res);
+	expect(ok && config.verbose == 3 && !config.color,
+			"-cvv --no-color -v counts 3 and turns color off");
+	xopt_result_free(&res);
+	expectError(ctx, "--verbose=2", XOPT_ERR_UNEXPECTED_VALUE, 0);
+
+	/* only booleans can be negated */
+	ok = parse(ctx, "--no-color", &config, &res);
+	expect(ok && !config.color, "--no-color");
+	xopt_result_free(&res);
+	expectError(ctx, "--no-color=1", XOPT_ERR_UNEXPECTED_VALUE, 0);
+	expectError(ctx, "--no-num", XOPT_ERR_INVALID, 0);
+	expectError(ctx, "--no-num=3", XOPT_ERR_INVALID, 0);
+	expectError(ctx, "--no-verbose", XOPT_ERR_INVALID, 0);
+	expectError(ctx, "--no-level", XOPT_ERR_INVALID, 0);
+	expectError(ctx, "--no-", XOPT_ERR_INVALID, 0);
+
+	printf("%d failures\n", failures);
+	xopt_context_free(ctx);
+	return failures ? 2 : 0;
+}
@@ -37,493 +37,3895 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <stdint.h>
+
+#ifndef XOPT_NOTHREADS
+#	include <pthread.h>
+#	include <unistd.h>
+#endif
+
+/* for the terminal's width, which has nothing to do with threads */
+#if defined(__unix__) || defined(__unix) \
+		|| (defined(__APPLE__) && defined(__MACH__))
+#	include <unistd.h>
+#	include <sys/ioctl.h>
+#endif
 
 #include "./xopt.h"
 #include "./snprintf.c"
+#include "./fastfloat.c"
 
 #define EXTRAS_INIT 10
+#define BATCH_CHUNK 8
+#define TYPE_MASK (0x3F | 0x3F80 | 0x38000 | 0x700000)
+#define LIST_MASK 0x3800
+#define DELIM_SHIFT 24
+#define ARENA_BLOCK 4096
+#define MAP_INIT 16
+#define HELP_COLUMNS 80
+#define HELP_WRAP_MIN 30
 #define ERRBUF_SIZE 1024 * 4
 
 static char errbuf[ERRBUF_SIZE];
 
+/* a slot in the long option index; `index' is the position of the option
+	 in the options list, or -1 for an empty slot */
+struct _xoptLongSlot {
+	unsigned long hash;
+	size_t length;
+	int index;
+};
+
+/* perfect hash over the names of an option's choices: a name's bucket picks
+	 a displacement, which mixed with the name's hash picks its slot. `linear'
+	 is set in the (unlikely) case no displacements could be found, and the
+	 choices are then simply scanned. */
+struct _xoptChoiceIndex {
+	size_t bucketMask;
+	size_t slotMask;
+	unsigned short *displace;
+	int *slots;
+	bool linear;
+};
+
+/* the strictest alignment anything stored in trailing memory needs */
+union _xoptAlign {
+	long double f;
+	uint64_t i;
+	void *p;
+};
+
+#define ALIGN_UP(n) \
+	(((n) + sizeof(union _xoptAlign) - 1) / sizeof(union _xoptAlign) \
+		* sizeof(union _xoptAlign))
+
+/* memory for list values: a chain of blocks (newest first), each followed
+	 by its storage, released all at once by xopt_result_free() */
+struct xoptArena {
+	struct xoptArena *next;
+	size_t size;
+	size_t used;
+	size_t last;
+};
+
+#define ARENA_DATA(block) \
+	((char*) (block) + ALIGN_UP(sizeof(struct xoptArena)))
+
+/* destination of the help renderer; like snprintf(), anything past `size'
+	 is measured but not stored */
+struct _xoptHelpBuf {
+	char *buf;
+	size_t size;
+	size_t length;
+};
+
 struct xoptContext {
 	const xoptOption *options;
 	long flags;
 	const char *name;
-	bool doubledash;
+	int count;
+	size_t longMask;
+	struct _xoptLongSlot *longSlots;
+	struct _xoptChoiceIndex *choiceIndex;
+	size_t helpWidth;
+	struct _xoptHelpCache *helpCache;
+	struct _xoptSearchIndex *searchIndex;
+	struct _xoptCompleteIndex *completeIndex;
+#ifndef XOPT_NOTHREADS
+	pthread_mutex_t helpLock;
+#endif
+	unsigned char shortValid[256 / 8];
+	int shortIndex[256];
+};
+
+/* a rendered help text, along with the autohelp options it was rendered
+	 with (their strings copied in after the text). along with the search
+	 and completion indexes, the only parts of a context that change after
+	 it's created: entries are only ever added (under `helpLock') and never
+	 change once they're visible. */
+struct _xoptHelpCache {
+	struct _xoptHelpCache *next;
+	const char *usage;
+	const char *prefix;
+	const char *suffix;
+	size_t spacer;
+	size_t columns;
+	size_t length;
+	char *text;
+};
+
+/* trigram index over the searchable text of every option (its long name,
+	 argDescrip and descrip, lowercased), built on the first search. `pairs'
+	 holds a (trigram << 32 | option) entry for every trigram that occurs in
+	 an option, sorted, so an option list per trigram is a binary search
+	 away. option i's text is text[start[i]] up to text[start[i + 1]]. */
+struct _xoptSearchIndex {
+	uint64_t *pairs;
+	size_t count;
+	size_t *start;
+	char *text;
+};
+
+/* every distinct long name, sorted, so that the names with a given prefix
+	 are a binary search away; built on the first completion */
+struct _xoptCompleteIndex {
+	const char **names;
+	size_t count;
+};
+
+/* per-parse state; a context is never modified once it's been created
+	 (short of caching help text, under a lock), so
+	 everything that changes while parsing lives here (and in the iterator)
+	 instead. this allows a single context to be shared by any number of
+	 (concurrent) parses. */
+struct _xoptState {
+	xoptIterator it;
+	void *data;
+	xoptResult *result;
+	size_t extrasCapac;
+	bool extrasFixed;
+	xoptExtraCallback extrasCallback;
+	void *extrasData;
+	struct _xoptRepeat *repeats;
+};
+
+/* values accumulated so far for an XOPT_REPEAT option (or the last list
+	 given for a list option), or the map of an XOPT_TYPE_MAP option */
+struct _xoptRepeat {
+	char *items;
+	size_t count;
+	size_t capacity;
+	struct xoptMap *map;
+};
+
+/* key=value pairs, in the order keys were first seen, indexed by an
+	 open-addressing (linear probing) table of entry positions; all of it
+	 lives in the parse result's arena */
+struct _xoptMapEntry {
+	const char *key;
+	size_t keyLength;
+	const char *value;
+	unsigned long hash;
 };
 
-static void _xopt_set_err(const char **err, const char *const fmt, ...);
-static bool _xopt_parse_arg(xoptContext *ctx, int argc, const char **argv,
-		int *argi, void *data, const char **err);
-static void _xopt_assert_increment(const char ***extras, int extrasCount,
-		size_t *extrasCapac, const char **err);
+struct xoptMap {
+	struct _xoptMapEntry *entries;
+	size_t count;
+	size_t capacity;
+	int *slots;
+	size_t slotMask;
+};
+
+#ifndef XOPT_NOTHREADS
+/* a batch being parsed by several threads; see xopt_parse_batch_mt() */
+struct _xoptBatchJob {
+	const xoptContext *ctx;
+	const int *argc;
+	const char ***argv;
+	void *data;
+	size_t stride;
+	xoptResult *results;
+	struct _xoptBatchWorker *workers;
+	unsigned threads;
+};
+
+/* each worker owns the range [next, end) of the batch, taking chunks off
+	 the front; once it runs dry it steals the back half of another worker's
+	 range, which keeps threads busy even when line lengths are very skewed */
+struct _xoptBatchWorker {
+	pthread_mutex_t lock;
+	pthread_t thread;
+	struct _xoptBatchJob *job;
+	size_t next;
+	size_t end;
+	size_t failed;
+};
+#endif
+
+#define _XOPT_SHORT_VALID(ctx, c) \
+	((ctx)->shortValid[(unsigned char) (c) >> 3] & (1 << ((unsigned char) (c) & 7)))
+
+static int _xopt_next_short(xoptIterator *it, const xoptOption **option,
+		const char **value);
+static int _xopt_next_long(xoptIterator *it, const char *arg,
+		const xoptOption **option, const char **value);
+static void _xopt_set_err(xoptIterator *it, int code, int argi, const char *at,
+		const xoptOption *option, bool longArg);
+static void _xopt_format_choices(const xoptError *error, char *buf,
+		size_t size);
+static size_t _xopt_help_render(const xoptContext *ctx,
+		const xoptAutohelpOptions *options, size_t columns, const int *subset,
+		size_t subsetCount, char *buf, size_t size);
+static size_t _xopt_help_width(const xoptOption *option);
+static bool _xopt_help_matches(const struct _xoptHelpCache *entry,
+		const xoptAutohelpOptions *options);
+static const struct _xoptHelpCache *_xopt_help_cached(const xoptContext *ctx,
+		const xoptAutohelpOptions *options, size_t columns, const char **err);
+static void _xopt_help_print(const xoptContext *ctx, FILE *stream,
+		const xoptAutohelpOptions *options, size_t columns, const char **err);
+static size_t _xopt_help_columns(FILE *stream);
+static void _xopt_help_wrap(struct _xoptHelpBuf *out, const char *str,
+		size_t indent, size_t avail);
+static size_t _xopt_help_display(const char *str);
+static size_t _xopt_utf8_char(const char *str, size_t *width);
+static size_t _xopt_char_width(unsigned long c);
+static const struct _xoptSearchIndex *_xopt_search_index(
+		const xoptContext *ctx, const char **err);
+static char *_xopt_search_append(char *to, const char *str);
+static int _xopt_search_compare(const void *a, const void *b);
+static const uint64_t *_xopt_search_find(const struct _xoptSearchIndex *index,
+		uint64_t key);
+static bool _xopt_search_contains(const char *text, const char *end,
+		const char *keyword, size_t length);
+static uint32_t _xopt_trigram(const char *str);
+static char _xopt_lower(char c);
+static const struct _xoptCompleteIndex *_xopt_complete_index(
+		const xoptContext *ctx, const char **err);
+static int _xopt_complete_compare(const void *a, const void *b);
+static void _xopt_complete_bash(const xoptContext *ctx,
+		struct _xoptHelpBuf *out);
+static void _xopt_complete_zsh(const xoptContext *ctx,
+		struct _xoptHelpBuf *out);
+static void _xopt_complete_fish(const xoptContext *ctx,
+		struct _xoptHelpBuf *out);
+static const char *_xopt_complete_command(const char *name);
+static void _xopt_complete_ident(struct _xoptHelpBuf *out, const char *name);
+static void _xopt_complete_pattern(struct _xoptHelpBuf *out,
+		const char *prefix, const char *name);
+static void _xopt_complete_words(struct _xoptHelpBuf *out,
+		const xoptChoice *choices, xoptShell shell);
+static void _xopt_complete_word(struct _xoptHelpBuf *out, const char *str,
+		xoptShell shell);
+static void _xopt_complete_quote(struct _xoptHelpBuf *out, const char *str,
+		xoptShell shell);
+static void _xopt_help_puts(struct _xoptHelpBuf *out, const char *str);
+static char *_xopt_help_copy(char *to, const char *str, const char **copy);
+static void _xopt_help_put(struct _xoptHelpBuf *out, const char *str,
+		size_t len);
+static void _xopt_help_fill(struct _xoptHelpBuf *out, char c, size_t count);
+static bool _xopt_parse(struct _xoptState *state, const xoptContext *ctx,
+		int argc, const char **argv);
+static void _xopt_push_extra(struct _xoptState *state, const char *extra);
+static void _xopt_batch_layout(size_t count, const int *argc,
+		const char **extras, xoptResult *results);
+static size_t _xopt_parse_batch_range(const xoptContext *ctx, size_t begin,
+		size_t end, const int *argc, const char ***argv, void *data,
+		size_t stride, xoptResult *results);
+#ifndef XOPT_NOTHREADS
+static void *_xopt_batch_worker(void *arg);
+static bool _xopt_batch_take(struct _xoptBatchWorker *worker, size_t *begin,
+		size_t *end);
+static bool _xopt_batch_steal(struct _xoptBatchWorker *worker);
+#endif
 static int _xopt_get_size(const char *arg);
-static int _xopt_get_arg(const char *arg, size_t len, const xoptOption *options,
+static int _xopt_get_arg(const xoptContext *ctx, const char *arg, size_t len,
 		int size, const xoptOption **option);
-static void _xopt_set(void *data, const xoptOption *option, const char *val,
-		bool longArg, const char **err);
-static void _xopt_default_callback(const char *value, void *data,
-		const xoptOption *option, bool longArg, const char **err);
+static int _xopt_arg_kind(const xoptOption *option);
+static bool _xopt_negatable(const xoptContext *ctx,
+		const xoptOption *option);
+static unsigned long _xopt_hash(const char *str, size_t len);
+static void _xopt_choice_size(const xoptOption *option, size_t *buckets,
+		size_t *slots);
+static void _xopt_choice_build(struct _xoptChoiceIndex *index,
+		const xoptChoice *choices);
+static uint32_t _xopt_choice_mix(uint32_t hash, unsigned displace);
+static int _xopt_choice_find(const xoptContext *ctx, const xoptOption *option,
+		const char *name, size_t len);
+static void _xopt_set(struct _xoptState *state, const xoptOption *option,
+		const char *val, bool longArg);
+static void _xopt_default_callback(struct _xoptState *state, const char *value,
+		const xoptOption *option, bool longArg);
+static int _xopt_set_int(const char *value, size_t len, long type,
+		void *target);
+static int _xopt_set_size(const char *value, uint64_t *target);
+static int _xopt_set_duration(const char *value, uint64_t *target);
+static int _xopt_parse_decimal(const char **str, uint64_t *value);
+static int _xopt_set_list(struct _xoptState *state, const char *value,
+		const xoptOption *option, const char **at);
+static int _xopt_set_flags(struct _xoptState *state, const char *value,
+		const xoptOption *option, uint64_t *target, const char **at);
+static char _xopt_delim(long options);
+static int _xopt_set_map(struct _xoptState *state, const char *value,
+		const xoptOption *option);
+static int _xopt_map_find(const struct xoptMap *map, const char *key,
+		size_t len, unsigned long hash);
+static bool _xopt_map_rehash(struct xoptMap *map, struct xoptArena **arena,
+		size_t slots);
+static size_t _xopt_repeat_width(long type);
+static struct _xoptRepeat *_xopt_repeat_get(struct _xoptState *state,
+		const xoptOption *option);
+static void *_xopt_repeat_reserve(struct _xoptState *state,
+		const xoptOption *option, size_t width, size_t count);
+static void _xopt_repeat_finish(struct _xoptState *state);
+static int _xopt_parse_int(const char *str, size_t len, uint64_t maxPos,
+		uint64_t maxNeg, bool *negative, uint64_t *magnitude);
+static bool _xopt_swar_digits8(const char *str, uint32_t *value);
+static uint64_t _xopt_load8(const char *str);
+static const char *_xopt_swar_find(const char *str, const char *end, char c);
+static size_t _xopt_swar_count(const char *str, const char *end, char c);
+static void *_xopt_arena_alloc(struct xoptArena **arena, size_t size);
+static void *_xopt_arena_grow(struct xoptArena **arena, void *ptr,
+		size_t oldSize, size_t size);
+static void _xopt_arena_free(struct xoptArena *arena);
+static int _xopt_parse_float(const char *str, size_t len, bool single,
+		void *target);
+static bool _xopt_match_word(const char *str, const char *end,
+		const char *word);
 
 xoptContext* xopt_context(const char *name, const xoptOption *options, long flags,
 		const char **err) {
 	xoptContext* ctx;
+	int count, i;
+	size_t slots, buckets, choiceSlots, size, ints, shorts;
+	bool hasChoices = false;
 	*err = 0;
 
-	/* malloc context and check */
-	ctx = malloc(sizeof(xoptContext));
+	/* count options and size the long option index to be at most half full */
+	for (count = 0; options[count].longArg || options[count].shortArg; count++);
+	for (slots = 4; slots < (size_t) count * 2; slots <<= 1);
+
+	/* total up the choice indexes; flags choices are bit numbers, which are
+		 used to index the target unchecked, so they can't be negative, and
+		 only some types have a list to repeat into */
+	ints = shorts = 0;
+	for (i = 0; i < count; i++) {
+		if ((options[i].options & XOPT_REPEAT)
+				&& !_xopt_repeat_width(options[i].options & TYPE_MASK)) {
+			*err = "XOPT_REPEAT only works with string, int32, int64, double and "
+				"list options";
+			return 0;
+		}
+
+		if ((options[i].options & TYPE_MASK) == XOPT_TYPE_FLAGS
+				&& options[i].choices) {
+			const xoptChoice *choice;
+			for (choice = options[i].choices; choice->name; choice++) {
+				if (choice->value < 0) {
+					*err = "flags choices must have bit numbers of 0 or more";
+					return 0;
+				}
+			}
+		}
+
+		if (options[i].choices) {
+			_xopt_choice_size(&options[i], &buckets, &choiceSlots);
+			ints += choiceSlots;
+			shorts += buckets;
+			hasChoices = true;
+		}
+	}
+
+	/* malloc context (with the indexes trailing it, in the same block) and
+		 check; what's built lazily later on is released by
+		 xopt_context_free() */
+	size = sizeof(xoptContext) + ALIGN_UP(sizeof(struct _xoptLongSlot) * slots);
+	if (hasChoices) {
+		size += ALIGN_UP(sizeof(struct _xoptChoiceIndex) * count)
+			+ ALIGN_UP(sizeof(int) * ints) + sizeof(unsigned short) * shorts;
+	}
+
+	ctx = malloc(size);
 	if (!ctx) {
 		ctx = 0;
-		_xopt_set_err(err, "could not allocate context");
+		*err = "could not allocate context";
 	} else {
+		size_t j;
+
 		ctx->options = options;
 		ctx->flags = flags;
 		ctx->name = name;
-		ctx->doubledash = false;
-	}
+		ctx->count = count;
+		ctx->longMask = slots - 1;
+		ctx->longSlots = (struct _xoptLongSlot *) (ctx + 1);
+		ctx->choiceIndex = 0;
+		ctx->helpWidth = 0;
+		ctx->helpCache = 0;
+		ctx->searchIndex = 0;
+		ctx->completeIndex = 0;
+#ifndef XOPT_NOTHREADS
+		pthread_mutex_init(&ctx->helpLock, 0);
+#endif
 
-	return ctx;
-}
+		for (j = 0; j < slots; j++) {
+			ctx->longSlots[j].index = -1;
+		}
 
-int xopt_parse(xoptContext *ctx, int argc, const char **argv, void* data,
-		const char ***inextras, const char **err) {
-	int argi;
-	int extrasCount;
-	size_t extrasCapac;
-	const char **extras;
-	bool parseResult;
+		/* hand out the choice index memory and build the indexes */
+		if (hasChoices) {
+			char *next = (char*) ctx->longSlots
+				+ ALIGN_UP(sizeof(struct _xoptLongSlot) * slots);
+			int *slotMem;
+			unsigned short *displaceMem;
+
+			ctx->choiceIndex = (struct _xoptChoiceIndex *) next;
+			slotMem = (int*) (next
+				+ ALIGN_UP(sizeof(struct _xoptChoiceIndex) * count));
+			displaceMem = (unsigned short *) ((char*) slotMem
+				+ ALIGN_UP(sizeof(int) * ints));
+
+			for (i = 0; i < count; i++) {
+				struct _xoptChoiceIndex *index = &ctx->choiceIndex[i];
+				if (!options[i].choices) {
+					continue;
+				}
 
-	*err = 0;
-	argi = 0;
-	extrasCount = 0;
-	extrasCapac = EXTRAS_INIT;
-	extras = malloc(sizeof(*extras) * EXTRAS_INIT);
+				_xopt_choice_size(&options[i], &buckets, &choiceSlots);
+				index->bucketMask = buckets - 1;
+				index->slotMask = choiceSlots - 1;
+				index->slots = slotMem;
+				index->displace = displaceMem;
+				slotMem += choiceSlots;
+				displaceMem += buckets;
 
-	/* check if extras malloc'd okay */
-	if (!extras) {
-		_xopt_set_err(err, "could not allocate extras array");
-		goto end;
-	}
+				_xopt_choice_build(index, options[i].choices);
+			}
+		}
 
-	/* increment argument counter if we aren't
-		 instructed to check argv[0] */
-	if (!(ctx->flags & XOPT_CTX_KEEPFIRST)) {
-		++argi;
-	}
+		/* the width of the autohelp option column only depends on the
+			 options, so it's worked out once, here */
+		for (i = 0; i < count; i++) {
+			size_t width = _xopt_help_width(&options[i]);
+			ctx->helpWidth = ctx->helpWidth > width ? ctx->helpWidth : width;
+		}
 
-	/* iterate over passed command line arguments */
-	for (; argi < argc; argi++) {
-		/* parse, breaking if there was a failure
-			 parseResult is true if extra, false if option */
-		parseResult = _xopt_parse_arg(ctx, argc, argv, &argi, data, err);
-		if (*err) {
-			break;
+		/* map short characters directly to their options; again, the first
+			 of any duplicates wins */
+		memset(ctx->shortValid, 0, sizeof(ctx->shortValid));
+		for (i = 0; i < count; i++) {
+			unsigned char c = (unsigned char) options[i].shortArg;
+			if (c && !_XOPT_SHORT_VALID(ctx, c)) {
+				ctx->shortValid[c >> 3] |= 1 << (c & 7);
+				ctx->shortIndex[c] = i;
+			}
 		}
 
-		/* is the argument an extra? */
-		if (parseResult) {
-			/* make sure we have enough room, or realloc if we don't -
-				 check that it succeeded */
-			_xopt_assert_increment(&extras, extrasCount, &extrasCapac, err);
-			if (*err) {
-				break;
+		/* index long names by hash (linear probing); the first of any
+			 duplicate names wins, as it did with a linear scan */
+		for (i = 0; i < count; i++) {
+			struct _xoptLongSlot *slot;
+			unsigned long hash;
+			size_t length;
+
+			if (!options[i].longArg) {
+				continue;
 			}
 
-			/* add extra to list */
-			extras[extrasCount++] = argv[argi];
-		} else {
-			/* make sure we're super-posix'd if specified to be
-				 (check that no extras have been specified when an option is parsed,
-				 enforcing options to be specific before [extra] arguments */
-			if ((ctx->flags & XOPT_CTX_POSIXMEHARDER) && extrasCount) {
-				_xopt_set_err(err, "options cannot be specified after arguments: %s",
-						argv[argi]);
-				break;
+			length = strlen(options[i].longArg);
+			hash = _xopt_hash(options[i].longArg, length);
+			for (j = hash & ctx->longMask;; j = (j + 1) & ctx->longMask) {
+				slot = &ctx->longSlots[j];
+				if (slot->index == -1) {
+					slot->hash = hash;
+					slot->length = length;
+					slot->index = i;
+					break;
+				}
+
+				if (slot->hash == hash && slot->length == length &&
+						!memcmp(options[slot->index].longArg, options[i].longArg,
+							length)) {
+					break;
+				}
 			}
 		}
 	}
 
-end:
-	if (!*err) {
-		/* append null terminator to extras */
-		_xopt_assert_increment(&extras, extrasCount, &extrasCapac, err);
-		if (!*err) {
-			extras[extrasCount] = 0;
+	return ctx;
+}
+
+void xopt_context_free(xoptContext *ctx) {
+	struct _xoptHelpCache *entry, *next;
+
+	if (!ctx) {
+		return;
+	}
+
+	for (entry = ctx->helpCache; entry; entry = next) {
+		next = entry->next;
+		free(entry);
+	}
+
+	free(ctx->searchIndex);
+	free(ctx->completeIndex);
+
+#ifndef XOPT_NOTHREADS
+	pthread_mutex_destroy(&ctx->helpLock);
+#endif
+	free(ctx);
+}
+
+int xopt_parse(const xoptContext *ctx, int argc, const char **argv, void* data,
+		const char ***inextras, const char **err) {
+	xoptResult result;
+	int i;
+
+	/* list, repeated and map values live in memory that only
+		 xopt_result_free() releases, which there's no handing back from here */
+	for (i = 0; i < ctx->count; i++) {
+		if (ctx->options[i].options & (LIST_MASK | XOPT_REPEAT | XOPT_TYPE_MAP)) {
+			*err = "list, repeated and map options need xopt_parse_r()";
+			*inextras = 0;
+			return 0;
 		}
 	}
 
-	if (*err) {
-		free(extras);
+	if (!xopt_parse_r(ctx, argc, argv, data, &result)) {
+		/* this is the one place a message is formatted into a shared buffer,
+			 which is what keeps this variant from being thread-safe */
+		*err = xopt_strerror(&result.error, &errbuf[0], ERRBUF_SIZE);
 		*inextras = 0;
 		return 0;
 	}
 
-	*inextras = extras;
-	return extrasCount;
+	*err = 0;
+	*inextras = result.extras;
+	return result.extrasCount;
 }
 
-void xopt_autohelp(xoptContext *ctx, FILE *stream, const xoptAutohelpOptions *options,
-		const char **err) {
-	const xoptOption *o;
-	size_t i, width = 0, twidth;
-	const char *nl = "";
-	size_t spacer = options ? options->spacer : 2;
+bool xopt_parse_r(const xoptContext *ctx, int argc, const char **argv,
+		void *data, xoptResult *result) {
+	struct _xoptState state;
 
-	*err = 0;
+	result->extras = malloc(sizeof(*result->extras) * EXTRAS_INIT);
+	result->ownsExtras = true;
+	state.extrasCapac = EXTRAS_INIT;
+	state.extrasFixed = false;
+	state.extrasCallback = 0;
 
-	if (options && options->usage) {
-		fprintf(stream, "%s%s\n", nl, options->usage);
-		nl = "\n";
+	/* check if extras malloc'd okay */
+	if (!result->extras) {
+		memset(&result->error, 0, sizeof(result->error));
+		result->error.code = XOPT_ERR_NOMEM;
+		result->error.message = "could not allocate extras array";
+		result->extrasCount = 0;
+		result->arena = 0;
+		return false;
 	}
 
-	if (options && options->prefix) {
-		fprintf(stream, "%s%s\n\n", nl, options->prefix);
-		nl = "\n";
+	state.data = data;
+	state.result = result;
+
+	if (!_xopt_parse(&state, ctx, argc, argv)) {
+		free(result->extras);
+		result->extras = 0;
+		result->extrasCount = 0;
+		return false;
 	}
 
-	/* find max width */
-	for (i = 0; ctx->options[i].longArg || ctx->options[i].shortArg; i++) {
-		o = &ctx->options[i];
-		twidth = 0;
-		if (o->longArg) {
-			twidth += 2 + strlen(o->longArg);
-			if (o->argDescrip) {
-				twidth += 1 + strlen(o->argDescrip);
-			}
-		}
-		if (ctx->options[i].shortArg) {
-			twidth += 2;
-		}
-		if (ctx->options[i].shortArg && ctx->options[i].longArg) {
-			twidth += 2; /* `, ` */
-		}
+	return true;
+}
+
+bool xopt_parse_buf(const xoptContext *ctx, int argc, const char **argv,
+		void *data, const char **extras, size_t capacity, xoptResult *result) {
+	struct _xoptState state;
+
+	result->extras = extras;
+	result->ownsExtras = false;
+	state.extrasCapac = capacity;
+	state.extrasFixed = true;
+	state.extrasCallback = 0;
+
+	state.data = data;
+	state.result = result;
 
-		width = width > twidth ? width : twidth;
+	if (!_xopt_parse(&state, ctx, argc, argv)) {
+		return false;
 	}
 
-	/* print */
-	for (i = 0; ctx->options[i].longArg || ctx->options[i].shortArg; i++) {
-		o = &ctx->options[i];
-		twidth = 0;
-		if (o->shortArg) {
-			fprintf(stream, "-%c", o->shortArg);
-			twidth += 2;
-		}
+	/* extras past the end of the buffer were only counted, so that the
+		 caller knows how much room to make */
+	if ((size_t) result->extrasCount >= capacity) {
+		result->error.code = XOPT_ERR_NOSPACE;
+		result->error.message = "extras buffer is too small";
+		return false;
+	}
 
-		if (o->shortArg && o->longArg) {
-			fprintf(stream, ", ");
-			twidth += 2;
-		}
+	return true;
+}
 
-		if (o->longArg) {
-			fprintf(stream, "--%s", o->longArg);
-			twidth += 2 + strlen(o->longArg);
-			if (o->argDescrip) {
-				fprintf(stream, "=%s", o->argDescrip);
-				twidth += 1 + strlen(o->argDescrip);
-			}
+bool xopt_parse_cb(const xoptContext *ctx, int argc, const char **argv,
+		void *data, xoptExtraCallback callback, void *callbackData,
+		xoptResult *result) {
+	struct _xoptState state;
+
+	result->extras = 0;
+	result->ownsExtras = false;
+	state.extrasCapac = 0;
+	state.extrasFixed = false;
+	state.extrasCallback = callback;
+	state.extrasData = callbackData;
+
+	state.data = data;
+	state.result = result;
+
+	return _xopt_parse(&state, ctx, argc, argv);
+}
+
+size_t xopt_parse_batch(const xoptContext *ctx, size_t count, const int *argc,
+		const char ***argv, void *data, size_t stride, const char **extras,
+		xoptResult *results) {
+	_xopt_batch_layout(count, argc, extras, results);
+	return _xopt_parse_batch_range(ctx, 0, count, argc, argv, data, stride,
+			results);
+}
+
+size_t xopt_parse_batch_mt(const xoptContext *ctx, size_t count,
+		const int *argc, const char ***argv, void *data, size_t stride,
+		const char **extras, xoptResult *results, unsigned threads) {
+#ifdef XOPT_NOTHREADS
+	(void) threads;
+	return xopt_parse_batch(ctx, count, argc, argv, data, stride, extras,
+			results);
+#else
+	struct _xoptBatchJob job;
+	struct _xoptBatchWorker *workers;
+	size_t failed = 0;
+	unsigned i;
+
+	if (!threads) {
+#	ifdef _SC_NPROCESSORS_ONLN
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = online > 0 ? (unsigned) online : 1;
+#	else
+		threads = 1;
+#	endif
+	}
+
+	/* no point in having more threads than command lines */
+	if (threads > count) {
+		threads = count ? (unsigned) count : 1;
+	}
+
+	workers = threads > 1 ? malloc(sizeof(*workers) * threads) : 0;
+	if (!workers) {
+		return xopt_parse_batch(ctx, count, argc, argv, data, stride, extras,
+				results);
+	}
+
+	/* the layout is fixed up front, so it's identical to xopt_parse_batch()'s
+		 no matter which thread ends up parsing which line */
+	_xopt_batch_layout(count, argc, extras, results);
+
+	job.ctx = ctx;
+	job.argc = argc;
+	job.argv = argv;
+	job.data = data;
+	job.stride = stride;
+	job.results = results;
+	job.workers = workers;
+	job.threads = threads;
+
+	/* deal out equal ranges to start with; stealing evens out the rest */
+	for (i = 0; i < threads; i++) {
+		pthread_mutex_init(&workers[i].lock, 0);
+		workers[i].job = &job;
+		workers[i].next = count * i / threads;
+		workers[i].end = count * (i + 1) / threads;
+		workers[i].failed = 0;
+	}
+
+	/* the calling thread is worker 0; if a thread can't be started, its
+		 range simply gets stolen by the others */
+	for (i = 1; i < threads; i++) {
+		if (pthread_create(&workers[i].thread, 0, &_xopt_batch_worker,
+				&workers[i])) {
+			workers[i].job = 0;
 		}
+	}
 
-		if (o->descrip) {
-			for (; twidth < (width + spacer); twidth++) {
-				fprintf(stream, " ");
-			}
+	_xopt_batch_worker(&workers[0]);
 
-			fprintf(stream, "%s\n", o->descrip);
+	/* every worker can still be stealing from every other worker's range
+		 (and taking its lock) until it's done, so all of them have to have
+		 finished before any lock is destroyed */
+	for (i = 1; i < threads; i++) {
+		if (workers[i].job) {
+			pthread_join(workers[i].thread, 0);
 		}
 	}
 
-	if (options && options->suffix) {
-		fprintf(stream, "%s%s\n", nl, options->suffix);
+	for (i = 0; i < threads; i++) {
+		failed += workers[i].failed;
+		pthread_mutex_destroy(&workers[i].lock);
 	}
+
+	free(workers);
+	return failed;
+#endif
 }
 
-static void _xopt_set_err(const char **err, const char *const fmt, ...) {
-	va_list list;
-	va_start(list, fmt);
-	rpl_vsnprintf(&errbuf[0], ERRBUF_SIZE, fmt, list);
-	va_end(list);
-	*err = &errbuf[0];
+void xopt_iter_init(xoptIterator *it, const xoptContext *ctx, int argc,
+		const char **argv) {
+	memset(&it->error, 0, sizeof(it->error));
+	it->ctx = ctx;
+	it->argc = argc;
+	it->argv = argv;
+	it->group = 0;
+	it->groupArgi = 0;
+	it->longArg = false;
+	it->negated = false;
+	it->doubledash = false;
+	it->sawExtra = false;
+
+	/* argi is advanced before each argument is looked at, so start one
+		 before the first argument we're meant to check */
+	it->argi = ctx->flags & XOPT_CTX_KEEPFIRST ? -1 : 0;
 }
 
-static bool _xopt_parse_arg(xoptContext *ctx, int argc, const char **argv,
-		int *argi, void *data, const char **err) {
-	int size;
+int xopt_next(xoptIterator *it, const xoptOption **option,
+		const char **value) {
+	const xoptContext *ctx = it->ctx;
+	const char *arg;
 	size_t length;
-	bool isExtra = false;
-	const char* arg = argv[*argi];
-
-	/* are we in doubledash mode? */
-	if (ctx->doubledash) {
-		return true;
-	}
-
-	/* get argument 'size' (long/short/extra) */
-	size = _xopt_get_size(arg);
+	int size;
+	int kind;
 
-	/* adjust to parse from beginning of actual content */
-	arg += size;
-	length = strlen(arg);
+	*option = 0;
+	*value = 0;
+	it->negated = false;
 
-	if (size == 1 && length == 0) {
-		/* it's just a singular dash - treat it as an extra arg */
-		return true;
+	/* errors are sticky */
+	if (it->error.code) {
+		return XOPT_NEXT_ERROR;
 	}
 
-	if (size == 2 && length == 0) {
-		/* double-dash - everything after this is an extra */
-		ctx->doubledash = 1;
-		return false;
+	/* still working through a set of condensed short options? */
+	if (it->group) {
+		kind = _xopt_next_short(it, option, value);
+		if (kind != XOPT_NEXT_END) {
+			return kind;
+		}
 	}
 
-	switch (size) {
-		const xoptOption *option;
-		int argRequirement;
-		char *valStart;
-	case 1: /* short */
-		if (length > 1 && ctx->flags & XOPT_CTX_NOCONDENSE) {
-			/* invalid argument? */
-			_xopt_set_err(err, "short options cannot be combined: %s", argv[*argi]);
-		} else if (length > 1 && ctx->flags & XOPT_CTX_SLOPPYSHORTS) {
-			/* get argument or error if not found and strict mode enabled. */
-			argRequirement = _xopt_get_arg(arg, 1, ctx->options, size, &option);
-			if (!option) {
-				if (ctx->flags & XOPT_CTX_STRICT) {
-					_xopt_set_err(err, "invalid option: -%c", arg[0]);
-				}
-				break;
-			}
+	for (;;) {
+		/* out of arguments? */
+		if (it->argi + 1 >= it->argc) {
+			it->argi = it->argc;
+			return XOPT_NEXT_END;
+		}
 
-			/* did they specify an arg when they shouldn't have? */
-			if (!argRequirement) {
-				_xopt_set_err(err, "option doesn't take a value: -%c", arg[0]);
-				break;
-			}
+		arg = it->argv[++it->argi];
 
-			/* set argument and check */
-			_xopt_set(data, option, arg + 1, false, err);
-			if (*err) {
-				break;
-			}
-		} else {
-			/* parse all */
-			while (length--) {
-				/* get argument or error if not found and strict mode enabled. */
-				argRequirement = _xopt_get_arg(arg++, 1, ctx->options, size, &option);
-				if (!option) {
-					if (ctx->flags & XOPT_CTX_STRICT) {
-						_xopt_set_err(err, "invalid option: -%c", arg[-1]);
-					}
-					break;
-				}
+		/* get argument 'size' (long/short/extra) */
+		size = _xopt_get_size(arg);
+		length = strlen(arg + size);
 
-				switch (argRequirement) {
-				case 0: /* flag; doesn't take an argument */
-					_xopt_set(data, option, 0, false, err);
-					break;
-				case 1: /* argument is optional */
-					/* is there another argument, and is it a non-option? */
-					if (*argi + 1 < argc && _xopt_get_size(argv[*argi + 1]) == 0) {
-						_xopt_set(data, option, argv[++*argi], false, err);
-					} else {
-						_xopt_set(data, option, 0, false, err);
-					}
-					break;
-				case 2: /* requires an argument */
-					/* is it the last in a set of condensed options? */
-					if (length == 0) {
-						/* is there another argument? */
-						if (*argi + 1 < argc) {
-							/* is the next argument actually an option?
-								 this indicates no value was passed */
-							if (_xopt_get_size(argv[*argi + 1])) {
-								_xopt_set_err(err, "missing option value: -%c",
-										option->shortArg);
-							} else {
-								_xopt_set(data, option, argv[++*argi], false, err);
-							}
-						} else {
-							_xopt_set_err(err, "missing option value: -%c",
-									option->shortArg);
-						}
-					} else {
-						_xopt_set_err(err, "combined short option requiring value is "
-								"not last: -%c", option->shortArg);
-					}
-					break;
-				}
-			}
+		/* are we in doubledash mode? is it an extra, or just a singular dash
+			 (which is also treated as an extra)? */
+		if (it->doubledash || size == 0 || (size == 1 && length == 0)) {
+			it->sawExtra = true;
+			*value = arg;
+			return XOPT_NEXT_EXTRA;
 		}
 
-		break;
-	case 2: /* long */
-		/* find first equals sign */
-		valStart = strchr(arg, '=');
+		/* make sure we're super-posix'd if specified to be
+			 (check that no extras have been specified when an option is parsed,
+			 enforcing options to be specific before [extra] arguments */
+		if ((ctx->flags & XOPT_CTX_POSIXMEHARDER) && it->sawExtra) {
+			_xopt_set_err(it, XOPT_ERR_AFTER_EXTRAS, it->argi, arg, 0, false);
+			return XOPT_NEXT_ERROR;
+		}
 
-		/* is there a value? */
-		if (valStart) {
-			/* we also increase valStart here in order to lop off
-				 the equals sign */
-			length = valStart++ - arg;
+		/* adjust to parse from beginning of actual content */
+		arg += size;
 
-			/* but not really, if it's null */
-			if (!*valStart) {
-				valStart = 0;
+		if (size == 2) {
+			if (length == 0) {
+				/* double-dash - everything after this is an extra */
+				it->doubledash = true;
+				continue;
 			}
-		}
 
-		/* get the option */
-		argRequirement = _xopt_get_arg(arg, length, ctx->options, size, &option);
-		if (!option) {
-			_xopt_set_err(err, "invalid option: --%.*s", length, arg);
-		} else {
-			switch (argRequirement) {
-			case 0: /* flag; doesn't take an argument */
-				if (valStart) {
-					_xopt_set_err(err, "option doesn't take a value: --%s", arg);
-				}
+			return _xopt_next_long(it, arg, option, value);
+		}
 
-				_xopt_set(data, option, valStart, true, err);
-				break;
-			case 2: /* requires an argument */
-				if (!valStart) {
-					_xopt_set_err(err, "missing option value: --%s", arg);
+		if (length > 1 && ctx->flags & XOPT_CTX_NOCONDENSE) {
+			/* invalid argument? */
+			_xopt_set_err(it, XOPT_ERR_CONDENSED, it->argi, arg, 0, false);
+			return XOPT_NEXT_ERROR;
+		} else if (length > 1 && ctx->flags & XOPT_CTX_SLOPPYSHORTS) {
+			/* get argument or error if not found and strict mode enabled. */
+			int argRequirement = _xopt_get_arg(ctx, arg, 1, size, option);
+			if (!*option) {
+				if (ctx->flags & XOPT_CTX_STRICT) {
+					_xopt_set_err(it, XOPT_ERR_INVALID, it->argi, arg, 0, false);
+					return XOPT_NEXT_ERROR;
 				}
-				break;
+				continue;
 			}
 
-			if (!*err) {
-				_xopt_set(data, option, valStart, true, err);
+			/* did they specify an arg when they shouldn't have? */
+			if (!argRequirement) {
+				_xopt_set_err(it, XOPT_ERR_UNEXPECTED_VALUE, it->argi, arg, *option,
+						false);
+				return XOPT_NEXT_ERROR;
 			}
-		}
-
-		break;
-	case 0: /* extra */
-		isExtra = true;
-		break;
-	}
-
-	return isExtra;
-}
 
-static void _xopt_assert_increment(const char ***extras, int extrasCount,
-		size_t *extrasCapac, const char **err) {
-	/* have we hit the list size limit? */
-	if ((size_t) extrasCount == *extrasCapac) {
-		/* increase capcity, realloc, and check for success */
-		*extrasCapac += EXTRAS_INIT;
-		*extras = realloc(*extras, sizeof(**extras) * *extrasCapac);
-		if (!*extras) {
-			_xopt_set_err(err, "could not realloc arguments array");
+			it->longArg = false;
+			*value = arg + 1;
+			return XOPT_NEXT_OPTION;
 		}
-	}
-}
 
-static int _xopt_get_size(const char *arg) {
-	int size;
-	for (size = 0; size < 2; size++) {
-		if (arg[size] != '-') {
-			break;
+		/* parse all, one at a time */
+		it->group = arg;
+		it->groupArgi = it->argi;
+		kind = _xopt_next_short(it, option, value);
+		if (kind != XOPT_NEXT_END) {
+			return kind;
 		}
 	}
-	return size;
 }
 
-static int _xopt_get_arg(const char *arg, size_t len, const xoptOption *options,
-		int size, const xoptOption **option) {
-	*option = 0;
-
-	/* find the argument */
-	for (; options[0].longArg || options[0].shortArg; options++) {
-		if (size == 1 && options[0].shortArg == arg[0]) {
-			*option = options;
-			break;
-		} else if (strlen(options[0].longArg) == len &&
-				!strncmp(options[0].longArg, arg, len)) {
-			*option = options;
-			break;
-		}
+void xopt_result_free(xoptResult *result) {
+	if (result->ownsExtras) {
+		free(result->extras);
 	}
 
-	/* determine the optionality of a value */
-	if (!*option || (*option)->options & XOPT_TYPE_BOOL) {
-		return 0;
-	} else if ((*option)->options & XOPT_OPTIONAL) {
-		return 1;
-	} else {
-		return 2;
-	}
+	_xopt_arena_free(result->arena);
+	result->arena = 0;
+	result->extras = 0;
+	result->extrasCount = 0;
 }
 
-static void _xopt_set(void *data, const xoptOption *option, const char *val,
-		bool longArg, const char **err) {
-	/* determine callback */
-	xoptCallback callback = option->callback ? option->callback : &_xopt_default_callback;
-
-	/* dispatch callback */
-	callback(val, data, option, longArg, err);
+const char *xopt_map_get(const xoptMap *map, const char *key) {
+	size_t len = strlen(key);
+	int i = _xopt_map_find(map, key, len, _xopt_hash(key, len));
+	return i < 0 ? 0 : map->entries[i].value;
 }
 
-static void _xopt_default_callback(const char *value, void *data,
-		const xoptOption *option, bool longArg, const char **err) {
-	void *target;
-	char *parsePtr = 0;
-
-	/* is a value specified? */
-	if ((!value || !strlen(value)) && !(option->options & XOPT_TYPE_BOOL)) {
-		/* we reach this point when they specified an optional, non-boolean
-			 option but didn't specify a custom handler (therefore, it's not
-			 optional).
+size_t xopt_map_count(const xoptMap *map) {
+	return map ? map->count : 0;
+}
 
-			 to fix, just remove the optional flag or specify a callback to handle
-			 it yourself.
-			 */
-		return;
+bool xopt_map_entry(const xoptMap *map, size_t index, const char **key,
+		size_t *keyLength, const char **value) {
+	if (!map || index >= map->count) {
+		return false;
 	}
 
-	/* get location */
-	target = ((char*) data) + option->offset;
+	*key = map->entries[index].key;
+	*keyLength = map->entries[index].keyLength;
+	*value = map->entries[index].value;
+	return true;
+}
 
-	/* switch on the type */
-	switch (option->options & 0x3F) {
-	case XOPT_TYPE_BOOL:
-		/* booleans are special in that they won't have an argument passed
-			 into this callback */
-		*((_Bool*) target) = true;
+const char *xopt_strerror(const xoptError *error, char *buf, size_t size) {
+	const char *at = error->arg ? error->arg + error->offset : "";
+	const xoptOption *option = error->option;
+
+	switch (error->code) {
+	case XOPT_ERR_NONE:
+		rpl_snprintf(buf, size, "no error");
 		break;
-	case XOPT_TYPE_STRING:
-		/* lifetime here works out fine; argv can usually be assumed static-like
-			 in nature */
-		*((const char**) target) = value;
+	case XOPT_ERR_NOMEM:
+	case XOPT_ERR_NOSPACE:
+	case XOPT_ERR_CALLBACK:
+		rpl_snprintf(buf, size, "%s", error->message);
 		break;
-	case XOPT_TYPE_INT:
-		*((int*) target) = (int) strtol(value, &parsePtr, 0);
+	case XOPT_ERR_INVALID:
+		if (error->longArg) {
+			rpl_snprintf(buf, size, "invalid option: --%.*s",
+					(int) strcspn(at, "="), at);
+		} else {
+			rpl_snprintf(buf, size, "invalid option: -%c", *at);
+		}
 		break;
-	case XOPT_TYPE_LONG:
-		*((long*) target) = strtol(value, &parsePtr, 0);
+	case XOPT_ERR_CONDENSED:
+		rpl_snprintf(buf, size, "short options cannot be combined: %s",
+				error->arg);
 		break;
-	case XOPT_TYPE_FLOAT:
-		*((float*) target) = (float) strtod(value, &parsePtr);
+	case XOPT_ERR_UNEXPECTED_VALUE:
+		if (error->longArg) {
+			rpl_snprintf(buf, size, "option doesn't take a value: --%s", at);
+		} else {
+			rpl_snprintf(buf, size, "option doesn't take a value: -%c", *at);
+		}
 		break;
-	case XOPT_TYPE_DOUBLE:
-		*((double*) target) = strtod(value, &parsePtr);
+	case XOPT_ERR_MISSING_VALUE:
+		if (error->longArg) {
+			rpl_snprintf(buf, size, "missing option value: --%s", at);
+		} else {
+			rpl_snprintf(buf, size, "missing option value: -%c",
+					option->shortArg);
+		}
 		break;
-	default: /* something wonky, or the implementation specifies two types */
-		fprintf(stderr, "warning: XOpt argument type invalid: %ld\n",
-			option->options & 0x2F);
+	case XOPT_ERR_NOT_LAST:
+		rpl_snprintf(buf, size,
+				"combined short option requiring value is not last: -%c",
+				option->shortArg);
+		break;
+	case XOPT_ERR_AFTER_EXTRAS:
+		rpl_snprintf(buf, size, "options cannot be specified after arguments: %s",
+				error->arg);
+		break;
+	case XOPT_ERR_NUMBER:
+		if (error->longArg) {
+			rpl_snprintf(buf, size, "value isn't a valid number: --%s=%s",
+					option->longArg, at);
+		} else {
+			rpl_snprintf(buf, size, "value isn't a valid number: -%c %s",
+					option->shortArg, at);
+		}
 		break;
+	case XOPT_ERR_RANGE:
+		if (error->longArg) {
+			rpl_snprintf(buf, size, "value is out of range: --%s=%s",
+					option->longArg, at);
+		} else {
+			rpl_snprintf(buf, size, "value is out of range: -%c %s",
+					option->shortArg, at);
+		}
+		break;
+	case XOPT_ERR_CHOICE:
+		_xopt_format_choices(error, buf, size);
+		break;
+	case XOPT_ERR_DUPLICATE:
+		if (error->longArg) {
+			rpl_snprintf(buf, size, "duplicate key: --%s=%s", option->longArg, at);
+		} else {
+			rpl_snprintf(buf, size, "duplicate key: -%c %s", option->shortArg, at);
+		}
+		break;
+	case XOPT_ERR_VALUE:
+		if (error->longArg) {
+			rpl_snprintf(buf, size, "missing key: --%s=%s", option->longArg, at);
+		} else {
+			rpl_snprintf(buf, size, "missing key: -%c %s", option->shortArg, at);
+		}
+		break;
+	default:
+		rpl_snprintf(buf, size, "unknown error: %d", error->code);
+		break;
+	}
+
+	return buf;
+}
+
+static void _xopt_format_choices(const xoptError *error, char *buf,
+		size_t size) {
+	/* the message, followed by as many of the valid choices as fit */
+	const xoptOption *option = error->option;
+	const char *at = error->arg ? error->arg + error->offset : "";
+	const xoptChoice *choice;
+	char delim[2];
+	int atLen = (int) strlen(at);
+	size_t len;
+
+	if (!size) {
+		return;
+	}
+
+	/* only show the offending name of a flag list */
+	if ((option->options & TYPE_MASK) == XOPT_TYPE_FLAGS) {
+		delim[0] = _xopt_delim(option->options);
+		delim[1] = 0;
+		atLen = (int) strcspn(at, delim);
+	}
+
+	if (error->longArg) {
+		rpl_snprintf(buf, size, "invalid choice: --%s=%.*s (expected",
+				option->longArg, atLen, at);
+	} else {
+		rpl_snprintf(buf, size, "invalid choice: -%c %.*s (expected",
+				option->shortArg, atLen, at);
+	}
+
+	for (choice = option->choices; choice && choice->name; choice++) {
+		len = strlen(buf);
+		rpl_snprintf(buf + len, size - len, "%s %s",
+				choice == option->choices ? "" : ",", choice->name);
+	}
+
+	len = strlen(buf);
+	rpl_snprintf(buf + len, size - len, ")");
+}
+
+size_t xopt_autohelp_render(const xoptContext *ctx,
+		const xoptAutohelpOptions *options, size_t columns, char *buf,
+		size_t size) {
+	return _xopt_help_render(ctx, options, columns, 0, 0, buf, size);
+}
+
+static size_t _xopt_help_render(const xoptContext *ctx,
+		const xoptAutohelpOptions *options, size_t columns, const int *subset,
+		size_t subsetCount, char *buf, size_t size) {
+	const xoptOption *o;
+	struct _xoptHelpBuf out;
+	const char *nl = "";
+	size_t spacer = options ? options->spacer : 2;
+	size_t column, twidth, i, total;
+
+	out.buf = buf;
+	out.size = size;
+	out.length = 0;
+
+	/* descriptions start in the column after the widest option; when
+		 wrapping, that's pulled in far enough to leave them some room, and
+		 any option wider than that gets its description on the next line */
+	column = ctx->helpWidth + spacer;
+	if (columns) {
+		size_t max = columns >= HELP_WRAP_MIN * 2
+			? columns - HELP_WRAP_MIN
+			: columns / 2;
+		column = column < max ? column : max;
+	}
+
+	if (options && options->usage) {
+		_xopt_help_wrap(&out, options->usage, 0, columns);
+		_xopt_help_put(&out, "\n", 1);
+		nl = "\n";
+	}
+
+	if (options && options->prefix) {
+		_xopt_help_put(&out, nl, strlen(nl));
+		_xopt_help_wrap(&out, options->prefix, 0, columns);
+		_xopt_help_put(&out, "\n\n", 2);
+		nl = "\n";
+	}
+
+	/* the option column width was found when the context was created, so
+		 every line can be laid out as it's reached */
+	total = subset ? subsetCount : (size_t) ctx->count;
+	for (i = 0; i < total; i++) {
+		o = &ctx->options[subset ? subset[i] : (int) i];
+
+		if (o->shortArg) {
+			char shortArg[2];
+			shortArg[0] = '-';
+			shortArg[1] = o->shortArg;
+			_xopt_help_put(&out, shortArg, 2);
+		}
+
+		if (o->shortArg && o->longArg) {
+			_xopt_help_put(&out, ", ", 2);
+		}
+
+		if (o->longArg) {
+			_xopt_help_put(&out, "--", 2);
+			_xopt_help_put(&out, o->longArg, strlen(o->longArg));
+			if (o->argDescrip) {
+				_xopt_help_put(&out, "=", 1);
+				_xopt_help_put(&out, o->argDescrip, strlen(o->argDescrip));
+			}
+		}
+
+		if (o->descrip) {
+			twidth = _xopt_help_width(o);
+			if (twidth + spacer > column) {
+				_xopt_help_put(&out, "\n", 1);
+				twidth = 0;
+			}
+
+			_xopt_help_fill(&out, ' ', column - twidth);
+			_xopt_help_wrap(&out, o->descrip, column,
+					columns ? columns - column : 0);
+		}
+
+		_xopt_help_put(&out, "\n", 1);
+	}
+
+	if (options && options->suffix) {
+		_xopt_help_put(&out, nl, strlen(nl));
+		_xopt_help_wrap(&out, options->suffix, 0, columns);
+		_xopt_help_put(&out, "\n", 1);
+	}
+
+	if (size) {
+		buf[out.length < size ? out.length : size - 1] = 0;
+	}
+
+	return out.length;
+}
+
+static const struct _xoptHelpCache *_xopt_help_cached(const xoptContext *ctx,
+		const xoptAutohelpOptions *options, size_t columns, const char **err) {
+	/* the cached text for these options and columns; called with the help
+		 lock held. each options value keeps only its latest rendering, so that
+		 ever-changing columns (a terminal being resized) can't grow the cache */
+	struct _xoptHelpCache *entry, **link;
+	size_t size, length;
+	char *next;
+
+	for (link = &((xoptContext *) ctx)->helpCache; *link;
+			link = &(*link)->next) {
+		if (_xopt_help_matches(*link, options)) {
+			break;
+		}
+	}
+
+	entry = *link;
+	if (entry && entry->columns == columns) {
+		return entry;
+	}
+
+	if (entry) {
+		*link = entry->next;
+		free(entry);
+	}
+
+	/* render the text into the same allocation as the entry and the copies
+		 of the options' strings */
+	length = xopt_autohelp_render(ctx, options, columns, 0, 0);
+	size = sizeof(*entry) + length + 1
+		+ (options->usage ? strlen(options->usage) + 1 : 0)
+		+ (options->prefix ? strlen(options->prefix) + 1 : 0)
+		+ (options->suffix ? strlen(options->suffix) + 1 : 0);
+
+	entry = malloc(size);
+	if (!entry) {
+		*err = "could not allocate help text";
+		return 0;
+	}
+
+	entry->text = (char*) (entry + 1);
+	entry->length = xopt_autohelp_render(ctx, options, columns, entry->text,
+			length + 1);
+	entry->spacer = options->spacer;
+	entry->columns = columns;
+
+	next = entry->text + entry->length + 1;
+	next = _xopt_help_copy(next, options->usage, &entry->usage);
+	next = _xopt_help_copy(next, options->prefix, &entry->prefix);
+	_xopt_help_copy(next, options->suffix, &entry->suffix);
+
+	entry->next = ctx->helpCache;
+	((xoptContext *) ctx)->helpCache = entry;
+	return entry;
+}
+
+static void _xopt_help_print(const xoptContext *ctx, FILE *stream,
+		const xoptAutohelpOptions *options, size_t columns, const char **err) {
+	/* written out under the lock, as another thread asking for other columns
+		 would replace the text */
+	const struct _xoptHelpCache *entry;
+	xoptAutohelpOptions defaults;
+
+	*err = 0;
+
+	if (!options) {
+		defaults.usage = defaults.prefix = defaults.suffix = 0;
+		defaults.spacer = 2;
+		options = &defaults;
+	}
+
+#ifndef XOPT_NOTHREADS
+	pthread_mutex_lock(&((xoptContext *) ctx)->helpLock);
+#endif
+
+	/* the text is rendered (once) into a single buffer, which stdio passes
+		 straight on to a single write */
+	entry = _xopt_help_cached(ctx, options, columns, err);
+	if (entry && fwrite(entry->text, 1, entry->length, stream) != entry->length) {
+		*err = "could not write help text";
+	}
+
+#ifndef XOPT_NOTHREADS
+	pthread_mutex_unlock(&((xoptContext *) ctx)->helpLock);
+#endif
+}
+
+const char *xopt_autohelp_text(const xoptContext *ctx,
+		const xoptAutohelpOptions *options, size_t columns, size_t *length,
+		const char **err) {
+	const struct _xoptHelpCache *entry;
+	xoptAutohelpOptions defaults;
+
+	*err = 0;
+
+	if (!options) {
+		defaults.usage = defaults.prefix = defaults.suffix = 0;
+		defaults.spacer = 2;
+		options = &defaults;
+	}
+
+#ifndef XOPT_NOTHREADS
+	pthread_mutex_lock(&((xoptContext *) ctx)->helpLock);
+#endif
+
+	entry = _xopt_help_cached(ctx, options, columns, err);
+
+#ifndef XOPT_NOTHREADS
+	pthread_mutex_unlock(&((xoptContext *) ctx)->helpLock);
+#endif
+
+	if (!entry) {
+		*length = 0;
+		return 0;
+	}
+
+	*length = entry->length;
+	return entry->text;
+}
+
+void xopt_autohelp(const xoptContext *ctx, FILE *stream, const xoptAutohelpOptions *options,
+		const char **err) {
+	if (!stream) {
+		stream = stderr;
 	}
 
-	/* check that our parsing functions worked */
-	if (parsePtr && *parsePtr) {
-		if (longArg) {
-			_xopt_set_err(err, "value isn't a valid number: --%s=%s",
-					(void*) option->longArg, value);
+	_xopt_help_print(ctx, stream, options, 0, err);
+}
+
+void xopt_autohelp_wrap(const xoptContext *ctx, FILE *stream,
+		const xoptAutohelpOptions *options, size_t columns, const char **err) {
+	if (!stream) {
+		stream = stderr;
+	}
+
+	if (!columns) {
+		columns = _xopt_help_columns(stream);
+	}
+
+	_xopt_help_print(ctx, stream, options, columns, err);
+}
+
+size_t xopt_search(const xoptContext *ctx, const char *keyword, int *matches,
+		size_t max, const char **err) {
+	const struct _xoptSearchIndex *index;
+	const uint64_t *first = 0, *last = 0, *from, *to;
+	size_t length = strlen(keyword), found = 0, candidates, i;
+	uint32_t gram;
+	int option;
+
+	*err = 0;
+
+	index = _xopt_search_index(ctx, err);
+	if (!index) {
+		return 0;
+	}
+
+	/* every trigram of the keyword must occur in a match, so only the
+		 options listed under its rarest trigram need checking. keywords too
+		 short to have one match too much of the table for an index to help,
+		 so they're simply checked against every option. */
+	if (length >= 3) {
+		for (i = 0; i + 3 <= length; i++) {
+			gram = _xopt_trigram(keyword + i);
+			from = _xopt_search_find(index, (uint64_t) gram << 32);
+			to = _xopt_search_find(index, (uint64_t) (gram + 1) << 32);
+			if (from == to) {
+				return 0;
+			}
+
+			if (!first || to - from < last - first) {
+				first = from;
+				last = to;
+			}
+		}
+	}
+
+	candidates = first ? (size_t) (last - first) : (size_t) ctx->count;
+	for (i = 0; i < candidates; i++) {
+		option = first ? (int) (first[i] & 0xFFFFFFFF) : (int) i;
+		if (_xopt_search_contains(index->text + index->start[option],
+					index->text + index->start[option + 1], keyword, length)) {
+			if (found < max) {
+				matches[found] = option;
+			}
+			++found;
+		}
+	}
+
+	return found;
+}
+
+size_t xopt_autohelp_search(const xoptContext *ctx, FILE *stream,
+		const xoptAutohelpOptions *options, const char *keyword, size_t columns,
+		const char **err) {
+	int *matches;
+	char *text;
+	size_t found, length;
+
+	*err = 0;
+
+	if (!stream) {
+		stream = stderr;
+	}
+
+	matches = malloc(sizeof(int) * (ctx->count ? ctx->count : 1));
+	if (!matches) {
+		*err = "could not allocate search results";
+		return 0;
+	}
+
+	found = xopt_search(ctx, keyword, matches, (size_t) ctx->count, err);
+	if (*err) {
+		free(matches);
+		return 0;
+	}
+
+	/* results depend on the keyword, so (unlike the full help) they're
+		 rendered fresh each time */
+	length = _xopt_help_render(ctx, options, columns, matches, found, 0, 0);
+	text = malloc(length + 1);
+	if (!text) {
+		*err = "could not allocate help text";
+	} else {
+		_xopt_help_render(ctx, options, columns, matches, found, text,
+				length + 1);
+		if (fwrite(text, 1, length, stream) != length) {
+			*err = "could not write help text";
+		}
+	}
+
+	free(text);
+	free(matches);
+	return found;
+}
+
+size_t xopt_complete(const xoptContext *ctx, const char *partial,
+		const char **matches, size_t max, const char **err) {
+	const struct _xoptCompleteIndex *index;
+	const xoptOption *option;
+	const xoptChoice *choice;
+	const char *value;
+	size_t length, found = 0, lo, hi, mid;
+
+	*err = 0;
+
+	if (partial[0] == '-' && partial[1] == '-') {
+		partial += 2;
+	}
+
+	/* --name=value completes the option's choices, if it has any */
+	value = strchr(partial, '=');
+	if (value) {
+		_xopt_get_arg(ctx, partial, (size_t) (value - partial), 2, &option);
+		length = strlen(++value);
+		for (choice = option ? option->choices : 0; choice && choice->name;
+				choice++) {
+			if (!strncmp(choice->name, value, length)) {
+				if (found < max) {
+					matches[found] = choice->name;
+				}
+				++found;
+			}
+		}
+
+		return found;
+	}
+
+	index = _xopt_complete_index(ctx, err);
+	if (!index) {
+		return 0;
+	}
+
+	/* the names starting with `partial' are the ones from the first name
+		 not below it, on until one doesn't start with it */
+	length = strlen(partial);
+	lo = 0;
+	hi = index->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strcmp(index->names[mid], partial) < 0) {
+			lo = mid + 1;
 		} else {
-			_xopt_set_err(err, "value isn't a valid number: -%c %s",
-					option->shortArg, value);
+			hi = mid;
+		}
+	}
+
+	for (; lo < index->count && !strncmp(index->names[lo], partial, length);
+			lo++) {
+		if (found < max) {
+			matches[found] = index->names[lo];
+		}
+		++found;
+	}
+
+	return found;
+}
+
+size_t xopt_completion_render(const xoptContext *ctx, xoptShell shell,
+		char *buf, size_t size) {
+	struct _xoptHelpBuf out;
+
+	out.buf = buf;
+	out.size = size;
+	out.length = 0;
+
+	switch (shell) {
+	case XOPT_SHELL_BASH:
+		_xopt_complete_bash(ctx, &out);
+		break;
+	case XOPT_SHELL_ZSH:
+		_xopt_complete_zsh(ctx, &out);
+		break;
+	case XOPT_SHELL_FISH:
+		_xopt_complete_fish(ctx, &out);
+		break;
+	}
+
+	if (size) {
+		buf[out.length < size ? out.length : size - 1] = 0;
+	}
+
+	return out.length;
+}
+
+void xopt_completion(const xoptContext *ctx, FILE *stream, xoptShell shell,
+		const char **err) {
+	char *text;
+	size_t length;
+
+	*err = 0;
+
+	if (!stream) {
+		stream = stdout;
+	}
+
+	length = xopt_completion_render(ctx, shell, 0, 0);
+	text = malloc(length + 1);
+	if (!text) {
+		*err = "could not allocate completion script";
+		return;
+	}
+
+	xopt_completion_render(ctx, shell, text, length + 1);
+	if (fwrite(text, 1, length, stream) != length) {
+		*err = "could not write completion script";
+	}
+
+	free(text);
+}
+
+static bool _xopt_help_matches(const struct _xoptHelpCache *entry,
+		const xoptAutohelpOptions *options) {
+	const char *mine[3], *theirs[3];
+	int i;
+
+	if (entry->spacer != options->spacer) {
+		return false;
+	}
+
+	mine[0] = entry->usage;
+	mine[1] = entry->prefix;
+	mine[2] = entry->suffix;
+	theirs[0] = options->usage;
+	theirs[1] = options->prefix;
+	theirs[2] = options->suffix;
+
+	/* compared by content, since callers are free to reuse their buffers */
+	for (i = 0; i < 3; i++) {
+		if (!mine[i] != !theirs[i] || (mine[i] && strcmp(mine[i], theirs[i]))) {
+			return false;
 		}
 	}
+
+	return true;
+}
+
+static char *_xopt_help_copy(char *to, const char *str, const char **copy) {
+	size_t length;
+
+	if (!str) {
+		*copy = 0;
+		return to;
+	}
+
+	length = strlen(str) + 1;
+	memcpy(to, str, length);
+	*copy = to;
+	return to + length;
+}
+
+static size_t _xopt_help_width(const xoptOption *option) {
+	size_t width = 0;
+
+	if (option->longArg) {
+		width += 2 + _xopt_help_display(option->longArg);
+		if (option->argDescrip) {
+			width += 1 + _xopt_help_display(option->argDescrip);
+		}
+	}
+	if (option->shortArg) {
+		width += 2;
+	}
+	if (option->shortArg && option->longArg) {
+		width += 2; /* `, ` */
+	}
+
+	return width;
+}
+
+static size_t _xopt_help_columns(FILE *stream) {
+	const char *env = getenv("COLUMNS");
+#ifdef TIOCGWINSZ
+	struct winsize size;
+
+	if (!ioctl(fileno(stream), TIOCGWINSZ, &size) && size.ws_col) {
+		return size.ws_col;
+	}
+#else
+	(void) stream;
+#endif
+
+	if (env && atoi(env) > 0) {
+		return (size_t) atoi(env);
+	}
+
+	return HELP_COLUMNS;
 }
 
+static void _xopt_help_wrap(struct _xoptHelpBuf *out, const char *str,
+		size_t indent, size_t avail) {
+	const char *p = str, *line = str, *space = 0;
+	size_t width = 0, spaceWidth = 0, w, n;
+
+	if (!avail) {
+		_xopt_help_put(out, str, strlen(str));
+		return;
+	}
+
+	/* greedy, in one pass: remember the last space on the line, and break
+		 there once the line overflows (or mid-word, if there wasn't one).
+		 `width' is in display columns, not bytes. */
+	while (*p) {
+		if (*p == '\n' || (*p == ' ' && width + 1 > avail)) {
+			_xopt_help_put(out, line, (size_t) (p - line));
+			line = ++p;
+		} else {
+			n = _xopt_utf8_char(p, &w);
+			if (width + w <= avail || !width) {
+				if (*p == ' ') {
+					space = p;
+					spaceWidth = width + 1;
+				}
+				width += w;
+				p += n;
+				continue;
+			}
+
+			if (space) {
+				_xopt_help_put(out, line, (size_t) (space - line));
+				line = space + 1;
+				width -= spaceWidth;
+				space = 0;
+				_xopt_help_put(out, "\n", 1);
+				_xopt_help_fill(out, ' ', indent);
+				continue;
+			}
+
+			_xopt_help_put(out, line, (size_t) (p - line));
+			line = p;
+		}
+
+		width = 0;
+		space = 0;
+		_xopt_help_put(out, "\n", 1);
+		_xopt_help_fill(out, ' ', indent);
+	}
+
+	_xopt_help_put(out, line, (size_t) (p - line));
+}
+
+static size_t _xopt_help_display(const char *str) {
+	size_t width = 0, w;
+
+	while (*str) {
+		str += _xopt_utf8_char(str, &w);
+		width += w;
+	}
+
+	return width;
+}
+
+static size_t _xopt_utf8_char(const char *str, size_t *width) {
+	const unsigned char *s = (const unsigned char *) str;
+	unsigned long c;
+	size_t n, i;
+
+	/* anything that isn't well-formed UTF-8 counts as a single column per
+		 byte, which is as good a guess as any */
+	*width = 1;
+	if (s[0] < 0x80) {
+		return 1;
+	} else if ((s[0] & 0xE0) == 0xC0) {
+		c = s[0] & 0x1F;
+		n = 2;
+	} else if ((s[0] & 0xF0) == 0xE0) {
+		c = s[0] & 0x0F;
+		n = 3;
+	} else if ((s[0] & 0xF8) == 0xF0) {
+		c = s[0] & 0x07;
+		n = 4;
+	} else {
+		return 1;
+	}
+
+	for (i = 1; i < n; i++) {
+		if ((s[i] & 0xC0) != 0x80) {
+			return 1;
+		}
+		c = (c << 6) | (s[i] & 0x3F);
+	}
+
+	*width = _xopt_char_width(c);
+	return n;
+}
+
+static size_t _xopt_char_width(unsigned long c) {
+	/* the common combining / zero-width and East Asian wide ranges; a full
+		 wcwidth() table isn't worth its weight for help text */
+	static const unsigned long zero[][2] = {
+		{0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x0610, 0x061A},
+		{0x064B, 0x065F}, {0x0E31, 0x0E31}, {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E},
+		{0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200B, 0x200F}, {0x202A, 0x202E},
+		{0x2060, 0x2064}, {0x20D0, 0x20FF}, {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F},
+		{0xFEFF, 0xFEFF}, {0xE0100, 0xE01EF}
+	};
+	static const unsigned long wide[][2] = {
+		{0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC},
+		{0x25FD, 0x25FE}, {0x2614, 0x2615}, {0x2E80, 0x303E}, {0x3041, 0x33FF},
+		{0x3400, 0x4DBF}, {0x4E00, 0x9FFF}, {0xA000, 0xA4CF}, {0xA960, 0xA97F},
+		{0xAC00, 0xD7A3}, {0xF900, 0xFAFF}, {0xFE10, 0xFE19}, {0xFE30, 0xFE6F},
+		{0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x1F300, 0x1F64F},
+		{0x1F900, 0x1F9FF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD}
+	};
+	size_t i;
+
+	/* both tables are sorted, so stop at the first range past `c' */
+	for (i = 0; i < sizeof(zero) / sizeof(zero[0]) && c >= zero[i][0]; i++) {
+		if (c <= zero[i][1]) {
+			return 0;
+		}
+	}
+
+	for (i = 0; i < sizeof(wide) / sizeof(wide[0]) && c >= wide[i][0]; i++) {
+		if (c <= wide[i][1]) {
+			return 2;
+		}
+	}
+
+	return 1;
+}
+
+static const struct _xoptSearchIndex *_xopt_search_index(
+		const xoptContext *ctx, const char **err) {
+	struct _xoptSearchIndex *index;
+	size_t textLength = 0, pairs = 0, length, i, j, size;
+	const char *end;
+	char *next;
+	int o;
+
+#ifndef XOPT_NOTHREADS
+	pthread_mutex_lock(&((xoptContext *) ctx)->helpLock);
+#endif
+
+	index = ctx->searchIndex;
+	if (index) {
+		goto done;
+	}
+
+	/* size everything up front; every option contributes at most one pair
+		 per trigram in its text */
+	for (o = 0; o < ctx->count; o++) {
+		length = 2;
+		length += ctx->options[o].longArg ? strlen(ctx->options[o].longArg) : 0;
+		length += ctx->options[o].argDescrip
+			? strlen(ctx->options[o].argDescrip) : 0;
+		length += ctx->options[o].descrip ? strlen(ctx->options[o].descrip) : 0;
+		textLength += length;
+		pairs += length >= 3 ? length - 2 : 0;
+	}
+
+	size = ALIGN_UP(sizeof(*index)) + ALIGN_UP(sizeof(uint64_t) * pairs)
+		+ ALIGN_UP(sizeof(size_t) * (ctx->count + 1)) + textLength + 1;
+	index = malloc(size);
+	if (!index) {
+		*err = "could not allocate search index";
+		goto done;
+	}
+
+	index->pairs = (uint64_t *) ((char*) index + ALIGN_UP(sizeof(*index)));
+	index->start = (size_t *) ((char*) index->pairs
+		+ ALIGN_UP(sizeof(uint64_t) * pairs));
+	index->text = (char*) index->start
+		+ ALIGN_UP(sizeof(size_t) * (ctx->count + 1));
+
+	/* lowercase every option's fields into one string (separated by line
+		 breaks, so that neither matches nor trigrams span two fields) */
+	next = index->text;
+	index->count = 0;
+	for (o = 0; o < ctx->count; o++) {
+		index->start[o] = (size_t) (next - index->text);
+		next = _xopt_search_append(next, ctx->options[o].longArg);
+		*next++ = '\n';
+		next = _xopt_search_append(next, ctx->options[o].argDescrip);
+		*next++ = '\n';
+		next = _xopt_search_append(next, ctx->options[o].descrip);
+
+		end = next;
+		for (next = index->text + index->start[o]; next + 3 <= end; next++) {
+			if (!memchr(next, '\n', 3)) {
+				index->pairs[index->count++] =
+					(uint64_t) _xopt_trigram(next) << 32 | (uint64_t) o;
+			}
+		}
+		next = (char*) end;
+	}
+	index->start[ctx->count] = (size_t) (next - index->text);
+	*next = 0;
+
+	/* sort, then drop repeats of a trigram within the same option */
+	qsort(index->pairs, index->count, sizeof(uint64_t), &_xopt_search_compare);
+	for (i = j = 0; i < index->count; i++) {
+		if (!j || index->pairs[j - 1] != index->pairs[i]) {
+			index->pairs[j++] = index->pairs[i];
+		}
+	}
+	index->count = j;
+
+	((xoptContext *) ctx)->searchIndex = index;
+
+done:
+#ifndef XOPT_NOTHREADS
+	pthread_mutex_unlock(&((xoptContext *) ctx)->helpLock);
+#endif
+	return index;
+}
+
+static char *_xopt_search_append(char *to, const char *str) {
+	for (; str && *str; str++) {
+		*to++ = _xopt_lower(*str);
+	}
+
+	return to;
+}
+
+static int _xopt_search_compare(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+static const uint64_t *_xopt_search_find(const struct _xoptSearchIndex *index,
+		uint64_t key) {
+	/* the first pair not below `key' */
+	size_t lo = 0, hi = index->count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (index->pairs[mid] < key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return index->pairs + lo;
+}
+
+static bool _xopt_search_contains(const char *text, const char *end,
+		const char *keyword, size_t length) {
+	size_t i;
+
+	for (; text + length <= end; text++) {
+		for (i = 0; i < length && text[i] == _xopt_lower(keyword[i]); i++);
+		if (i == length) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static uint32_t _xopt_trigram(const char *str) {
+	return (uint32_t) (unsigned char) _xopt_lower(str[0]) << 16
+		| (uint32_t) (unsigned char) _xopt_lower(str[1]) << 8
+		| (uint32_t) (unsigned char) _xopt_lower(str[2]);
+}
+
+static char _xopt_lower(char c) {
+	/* ASCII only (and locale independent); other bytes match exactly */
+	return c >= 'A' && c <= 'Z' ? (char) (c - 'A' + 'a') : c;
+}
+
+static const struct _xoptCompleteIndex *_xopt_complete_index(
+		const xoptContext *ctx, const char **err) {
+	struct _xoptCompleteIndex *index;
+	size_t i, j, count = 0, textSize = 0;
+	char *text;
+	int o;
+
+#ifndef XOPT_NOTHREADS
+	pthread_mutex_lock(&((xoptContext *) ctx)->helpLock);
+#endif
+
+	index = ctx->completeIndex;
+	if (index) {
+		goto done;
+	}
+
+	/* every long name, and the no-<name> of each boolean, which are spelled
+		 out after the names */
+	for (o = 0; o < ctx->count; o++) {
+		if (ctx->options[o].longArg) {
+			++count;
+		}
+		if (_xopt_negatable(ctx, &ctx->options[o])) {
+			++count;
+			textSize += strlen(ctx->options[o].longArg) + 4;
+		}
+	}
+
+	index = malloc(ALIGN_UP(sizeof(*index))
+		+ sizeof(const char *) * (count ? count : 1) + textSize);
+	if (!index) {
+		*err = "could not allocate completion index";
+		goto done;
+	}
+
+	index->names = (const char **) ((char*) index + ALIGN_UP(sizeof(*index)));
+	index->count = 0;
+	text = (char*) (index->names + (count ? count : 1));
+	for (o = 0; o < ctx->count; o++) {
+		if (ctx->options[o].longArg) {
+			index->names[index->count++] = ctx->options[o].longArg;
+		}
+		if (_xopt_negatable(ctx, &ctx->options[o])) {
+			index->names[index->count++] = text;
+			memcpy(text, "no-", 3);
+			strcpy(text + 3, ctx->options[o].longArg);
+			text += strlen(text) + 1;
+		}
+	}
+
+	qsort(index->names, index->count, sizeof(const char *),
+			&_xopt_complete_compare);
+	for (i = j = 0; i < index->count; i++) {
+		if (!j || strcmp(index->names[j - 1], index->names[i])) {
+			index->names[j++] = index->names[i];
+		}
+	}
+	index->count = j;
+
+	((xoptContext *) ctx)->completeIndex = index;
+
+done:
+#ifndef XOPT_NOTHREADS
+	pthread_mutex_unlock(&((xoptContext *) ctx)->helpLock);
+#endif
+	return index;
+}
+
+static int _xopt_complete_compare(const void *a, const void *b) {
+	return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+static void _xopt_complete_bash(const xoptContext *ctx,
+		struct _xoptHelpBuf *out) {
+	const xoptOption *o;
+	const char *command = _xopt_complete_command(ctx->name);
+	char shortArg[3];
+	int i, kind;
+
+	_xopt_help_puts(out, "# bash completion for '");
+	_xopt_complete_quote(out, command, XOPT_SHELL_BASH);
+	_xopt_help_puts(out, "', generated by xopt\n\n");
+	_xopt_complete_ident(out, command);
+	_xopt_help_puts(out, "() {\n"
+		"\tlocal cur=\"${COMP_WORDS[COMP_CWORD]}\"\n"
+		"\tlocal prev=\"${COMP_WORDS[COMP_CWORD-1]}\"\n"
+		"\tlocal word words\n"
+		"\n"
+		"\t# bash splits --name=value into three words; mark values given\n"
+		"\t# that way (the only way to give an optional one) with a '='\n"
+		"\tif [[ \"$cur\" == \"=\" ]]; then\n"
+		"\t\tcur=\"\"\n"
+		"\t\tprev=\"=$prev\"\n"
+		"\telif [[ \"$prev\" == \"=\" ]]; then\n"
+		"\t\tprev=\"=${COMP_WORDS[COMP_CWORD-2]}\"\n"
+		"\tfi\n"
+		"\n"
+		"\tcase \"$prev\" in\n");
+
+	shortArg[0] = '-';
+	for (i = 0; i < ctx->count; i++) {
+		o = &ctx->options[i];
+		kind = _xopt_arg_kind(o);
+		if (!kind || (kind == 1 && !o->longArg)) {
+			continue;
+		}
+
+		/* quoted, so that names like `?' aren't taken for patterns */
+		_xopt_help_puts(out, "\t");
+		if (kind == 2 && o->shortArg) {
+			shortArg[1] = o->shortArg;
+			shortArg[2] = 0;
+			_xopt_complete_pattern(out, "-", shortArg + 1);
+			_xopt_help_puts(out, o->longArg ? "|" : "");
+		}
+		if (kind == 2 && o->longArg) {
+			_xopt_complete_pattern(out, "--", o->longArg);
+			_xopt_help_puts(out, "|");
+		}
+		if (o->longArg) {
+			_xopt_complete_pattern(out, "=--", o->longArg);
+		}
+
+		if (o->choices) {
+			_xopt_help_puts(out, ")\n\t\twords=(");
+			_xopt_complete_words(out, o->choices, XOPT_SHELL_BASH);
+			_xopt_help_puts(out, ");;\n");
+		} else if (o->options & XOPT_TYPE_STRING) {
+			_xopt_help_puts(out, ")\n\t\tCOMPREPLY=($(compgen -f -- \"$cur\"))\n"
+				"\t\treturn;;\n");
+		} else {
+			_xopt_help_puts(out, ")\n\t\tCOMPREPLY=()\n\t\treturn;;\n");
+		}
+	}
+
+	_xopt_help_puts(out, "\t*)\n"
+		"\t\tif [[ \"$cur\" != -* ]]; then\n"
+		"\t\t\tCOMPREPLY=($(compgen -f -- \"$cur\"))\n"
+		"\t\t\treturn\n"
+		"\t\tfi\n"
+		"\t\twords=(");
+	for (i = 0; i < ctx->count; i++) {
+		o = &ctx->options[i];
+		if (o->longArg) {
+			_xopt_help_puts(out, i ? " '--" : "'--");
+			_xopt_complete_quote(out, o->longArg, XOPT_SHELL_BASH);
+			_xopt_help_puts(out, "'");
+		}
+		if (_xopt_negatable(ctx, o)) {
+			_xopt_help_puts(out, " '--no-");
+			_xopt_complete_quote(out, o->longArg, XOPT_SHELL_BASH);
+			_xopt_help_puts(out, "'");
+		}
+		if (o->shortArg) {
+			_xopt_help_puts(out, i || o->longArg ? " '-" : "'-");
+			shortArg[1] = o->shortArg;
+			shortArg[2] = 0;
+			_xopt_complete_quote(out, shortArg + 1, XOPT_SHELL_BASH);
+			_xopt_help_puts(out, "'");
+		}
+	}
+	_xopt_help_puts(out, ");;\n"
+		"\tesac\n"
+		"\n"
+		"\t# matched by hand, as compgen -W would expand the words\n"
+		"\tfor word in \"${words[@]}\"; do\n"
+		"\t\t[[ \"$word\" == \"$cur\"* ]] && COMPREPLY+=(\"$word\")\n"
+		"\tdone\n"
+		"}\n"
+		"\n"
+		"complete -F ");
+	_xopt_complete_ident(out, command);
+	_xopt_help_puts(out, " '");
+	_xopt_complete_quote(out, command, XOPT_SHELL_BASH);
+	_xopt_help_puts(out, "'\n");
+}
+
+static void _xopt_complete_zsh(const xoptContext *ctx,
+		struct _xoptHelpBuf *out) {
+	const xoptOption *o;
+	const char *command = _xopt_complete_command(ctx->name);
+	char shortArg[3];
+	int i, pass, kind;
+
+	/* a function bound with compdef rather than a #compdef file, as the
+		 latter has no way of quoting the command's name */
+	_xopt_help_puts(out, "# zsh completion for '");
+	_xopt_complete_quote(out, command, XOPT_SHELL_BASH);
+	_xopt_help_puts(out, "', generated by xopt; source it after compinit\n\n");
+	_xopt_complete_ident(out, command);
+	_xopt_help_puts(out, "() {\n\t_arguments -s \\\n");
+
+	/* one spec per short and per long form: '-n+[descrip]:arg:action' or
+		 '--name=[descrip]:arg:action' (with `::' for optional values, and a
+		 leading `*' for options that can be repeated) */
+	shortArg[0] = '-';
+	for (i = 0; i < ctx->count; i++) {
+		o = &ctx->options[i];
+		kind = _xopt_arg_kind(o);
+
+		for (pass = 0; pass < 2; pass++) {
+			if (pass ? !o->longArg : !o->shortArg) {
+				continue;
+			}
+
+			_xopt_help_puts(out, "\t\t'");
+			if (o->options & (XOPT_REPEAT | XOPT_TYPE_COUNTER | XOPT_TYPE_MAP)) {
+				_xopt_help_puts(out, "*");
+			}
+
+			if (pass) {
+				_xopt_help_puts(out, "--");
+				_xopt_complete_quote(out, o->longArg, XOPT_SHELL_ZSH);
+				_xopt_help_puts(out, kind == 2 ? "=" : kind == 1 ? "=-" : "");
+			} else {
+				shortArg[1] = o->shortArg;
+				shortArg[2] = 0;
+				_xopt_complete_quote(out, shortArg, XOPT_SHELL_ZSH);
+				_xopt_help_puts(out, kind ? "+" : "");
+			}
+
+			if (o->descrip) {
+				_xopt_help_puts(out, "[");
+				_xopt_complete_quote(out, o->descrip, XOPT_SHELL_ZSH);
+				_xopt_help_puts(out, "]");
+			}
+
+			if (kind) {
+				_xopt_help_puts(out, kind == 1 ? "::" : ":");
+				_xopt_complete_quote(out, o->argDescrip ? o->argDescrip : "value",
+						XOPT_SHELL_ZSH);
+				if (o->choices) {
+					_xopt_help_puts(out, ":(");
+					_xopt_complete_words(out, o->choices, XOPT_SHELL_ZSH);
+					_xopt_help_puts(out, ")");
+				} else if (o->options & XOPT_TYPE_STRING) {
+					_xopt_help_puts(out, ":_files");
+				} else {
+					_xopt_help_puts(out, ": ");
+				}
+			}
+
+			_xopt_help_puts(out, "' \\\n");
+		}
+
+		if (_xopt_negatable(ctx, o)) {
+			_xopt_help_puts(out, "\t\t'--no-");
+			_xopt_complete_quote(out, o->longArg, XOPT_SHELL_ZSH);
+			_xopt_help_puts(out, "[turns off --");
+			_xopt_complete_quote(out, o->longArg, XOPT_SHELL_ZSH);
+			_xopt_help_puts(out, "]' \\\n");
+		}
+	}
+
+	_xopt_help_puts(out, "\t\t'*:file:_files'\n"
+		"}\n"
+		"\n"
+		"compdef ");
+	_xopt_complete_ident(out, command);
+	_xopt_help_puts(out, " '");
+	_xopt_complete_quote(out, command, XOPT_SHELL_BASH);
+	_xopt_help_puts(out, "'\n");
+}
+
+static void _xopt_complete_fish(const xoptContext *ctx,
+		struct _xoptHelpBuf *out) {
+	const xoptOption *o;
+	const char *command = _xopt_complete_command(ctx->name);
+	char shortArg[2];
+	int i, kind;
+
+	_xopt_help_puts(out, "# fish completion for '");
+	_xopt_complete_quote(out, command, XOPT_SHELL_FISH);
+	_xopt_help_puts(out, "', generated by xopt\n\n");
+
+	/* -r: takes a value; -x: takes a value, and it isn't a file */
+	shortArg[1] = 0;
+	for (i = 0; i < ctx->count; i++) {
+		o = &ctx->options[i];
+		kind = _xopt_arg_kind(o);
+
+		_xopt_help_puts(out, "complete -c '");
+		_xopt_complete_quote(out, command, XOPT_SHELL_FISH);
+		if (o->shortArg) {
+			shortArg[0] = o->shortArg;
+			_xopt_help_puts(out, "' -s '");
+			_xopt_complete_quote(out, shortArg, XOPT_SHELL_FISH);
+		}
+		if (o->longArg) {
+			_xopt_help_puts(out, "' -l '");
+			_xopt_complete_quote(out, o->longArg, XOPT_SHELL_FISH);
+		}
+		_xopt_help_puts(out, "'");
+
+		if (kind == 2) {
+			_xopt_help_puts(out, o->choices || !(o->options & XOPT_TYPE_STRING)
+					? " -x" : " -r");
+		}
+		if (kind && o->choices) {
+			_xopt_help_puts(out, " -a ");
+			_xopt_complete_words(out, o->choices, XOPT_SHELL_FISH);
+		}
+
+		if (o->descrip) {
+			_xopt_help_puts(out, " -d '");
+			_xopt_complete_quote(out, o->descrip, XOPT_SHELL_FISH);
+			_xopt_help_puts(out, "'");
+		}
+
+		_xopt_help_puts(out, "\n");
+
+		if (_xopt_negatable(ctx, o)) {
+			_xopt_help_puts(out, "complete -c '");
+			_xopt_complete_quote(out, command, XOPT_SHELL_FISH);
+			_xopt_help_puts(out, "' -l 'no-");
+			_xopt_complete_quote(out, o->longArg, XOPT_SHELL_FISH);
+			_xopt_help_puts(out, "' -d 'Turns off --");
+			_xopt_complete_quote(out, o->longArg, XOPT_SHELL_FISH);
+			_xopt_help_puts(out, "'\n");
+		}
+	}
+}
+
+static const char *_xopt_complete_command(const char *name) {
+	/* the context is usually named after argv[0], which may well be a path;
+		 completion is bound to the bare command */
+	const char *slash = strrchr(name, '/');
+	return slash && slash[1] ? slash + 1 : name;
+}
+
+static void _xopt_complete_pattern(struct _xoptHelpBuf *out,
+		const char *prefix, const char *name) {
+	/* one single-quoted alternative of a bash case pattern */
+	_xopt_help_puts(out, "'");
+	_xopt_help_puts(out, prefix);
+	_xopt_complete_quote(out, name, XOPT_SHELL_BASH);
+	_xopt_help_puts(out, "'");
+}
+
+static void _xopt_complete_ident(struct _xoptHelpBuf *out, const char *name) {
+	char c;
+
+	/* the name of the completion function */
+	_xopt_help_puts(out, "_xopt_complete_");
+	for (; *name; name++) {
+		c = (*name >= 'a' && *name <= 'z') || (*name >= 'A' && *name <= 'Z')
+			|| (*name >= '0' && *name <= '9') ? *name : '_';
+		_xopt_help_put(out, &c, 1);
+	}
+}
+
+static void _xopt_complete_words(struct _xoptHelpBuf *out,
+		const xoptChoice *choices, xoptShell shell) {
+	const xoptChoice *choice;
+
+	/* a space separated list: of quoted words (bash), inside parentheses
+		 (zsh) or inside one pair of quotes (fish) */
+	_xopt_help_puts(out, shell == XOPT_SHELL_FISH ? "'" : "");
+	for (choice = choices; choice->name; choice++) {
+		_xopt_help_puts(out, choice == choices ? "" : " ");
+		if (shell == XOPT_SHELL_BASH) {
+			_xopt_help_puts(out, "'");
+			_xopt_complete_quote(out, choice->name, shell);
+			_xopt_help_puts(out, "'");
+		} else {
+			_xopt_complete_word(out, choice->name, shell);
+		}
+	}
+	_xopt_help_puts(out, shell == XOPT_SHELL_FISH ? "'" : "");
+}
+
+static void _xopt_complete_word(struct _xoptHelpBuf *out, const char *str,
+		xoptShell shell) {
+	/* zsh and fish split their word lists as shell words (and expand them),
+		 so anything but plain characters is escaped with a backslash; that
+		 goes inside the spec's single quotes (zsh), where backslashes stay
+		 as they are, or inside fish's, where it has to be doubled */
+	char c[2];
+
+	c[1] = 0;
+	for (; *str; str++) {
+		c[0] = *str == '\n' ? ' ' : *str;
+		if ((c[0] >= 'a' && c[0] <= 'z') || (c[0] >= 'A' && c[0] <= 'Z')
+				|| (c[0] >= '0' && c[0] <= '9') || (unsigned char) c[0] >= 0x80
+				|| strchr("-_.,+/@%=", c[0])) {
+			_xopt_help_puts(out, c);
+			continue;
+		}
+
+		_xopt_help_puts(out, shell == XOPT_SHELL_FISH ? "\\\\" : "\\");
+		if (c[0] == '\'') {
+			_xopt_help_puts(out, shell == XOPT_SHELL_FISH ? "\\'" : "'\\''");
+		} else if (c[0] == '\\' && shell == XOPT_SHELL_FISH) {
+			_xopt_help_puts(out, "\\\\");
+		} else {
+			_xopt_help_puts(out, c);
+		}
+	}
+}
+
+static void _xopt_complete_quote(struct _xoptHelpBuf *out, const char *str,
+		xoptShell shell) {
+	const char *from = str;
+	const char *escape;
+
+	/* escapes text for inside single quotes (bash, fish) or an _arguments
+		 spec in single quotes (zsh); line breaks become spaces */
+	switch (shell) {
+	case XOPT_SHELL_BASH:
+		escape = "";
+		break;
+	case XOPT_SHELL_ZSH:
+		escape = "[]:()\\";
+		break;
+	default:
+		escape = "'\\";
+		break;
+	}
+
+	for (; *str; str++) {
+		if (*str == '\'' && shell != XOPT_SHELL_FISH) {
+			_xopt_help_put(out, from, (size_t) (str - from));
+			_xopt_help_puts(out, "'\\''");
+			from = str + 1;
+		} else if (*str == '\n') {
+			_xopt_help_put(out, from, (size_t) (str - from));
+			_xopt_help_puts(out, " ");
+			from = str + 1;
+		} else if (strchr(escape, *str)) {
+			_xopt_help_put(out, from, (size_t) (str - from));
+			_xopt_help_puts(out, "\\");
+			from = str;
+		}
+	}
+
+	_xopt_help_put(out, from, (size_t) (str - from));
+}
+
+static void _xopt_help_puts(struct _xoptHelpBuf *out, const char *str) {
+	_xopt_help_put(out, str, strlen(str));
+}
+
+static void _xopt_help_put(struct _xoptHelpBuf *out, const char *str,
+		size_t len) {
+	if (out->length < out->size) {
+		size_t room = out->size - out->length;
+		memcpy(out->buf + out->length, str, len < room ? len : room);
+	}
+	out->length += len;
+}
+
+static void _xopt_help_fill(struct _xoptHelpBuf *out, char c, size_t count) {
+	if (out->length < out->size) {
+		size_t room = out->size - out->length;
+		memset(out->buf + out->length, c, count < room ? count : room);
+	}
+	out->length += count;
+}
+
+static void _xopt_set_err(xoptIterator *it, int code, int argi, const char *at,
+		const xoptOption *option, bool longArg) {
+	/* only the facts are recorded here - xopt_strerror() does the (much more
+		 expensive) formatting, if and when somebody asks for it */
+	xoptError *error = &it->error;
+	error->code = code;
+	error->argi = argi;
+	error->arg = argi >= 0 && argi < it->argc ? it->argv[argi] : 0;
+	error->offset = at && error->arg ? (size_t) (at - error->arg) : 0;
+	error->option = option;
+	error->longArg = longArg;
+	error->message = 0;
+}
+
+static bool _xopt_parse(struct _xoptState *state, const xoptContext *ctx,
+		int argc, const char **argv) {
+	xoptResult *result = state->result;
+	const xoptOption *option;
+	const char *value;
+	int kind;
+
+	result->extrasCount = 0;
+	result->arena = 0;
+	state->repeats = 0;
+	xopt_iter_init(&state->it, ctx, argc, argv);
+
+	/* iterate over passed command line arguments, applying options and
+		 collecting extras until we run out or there was a failure */
+	while ((kind = xopt_next(&state->it, &option, &value)) > 0) {
+		if (kind == XOPT_NEXT_EXTRA) {
+			_xopt_push_extra(state, value);
+		} else {
+			_xopt_set(state, option, value, state->it.longArg);
+		}
+
+		if (state->it.error.code) {
+			break;
+		}
+	}
+
+	if (!state->it.error.code) {
+		/* append null terminator to extras */
+		_xopt_push_extra(state, 0);
+		--result->extrasCount;
+
+		/* hand out the accumulated values of repeated options */
+		_xopt_repeat_finish(state);
+	}
+
+	result->error = state->it.error;
+	if (result->error.code) {
+		/* nothing is handed out on failure */
+		_xopt_arena_free(result->arena);
+		result->arena = 0;
+		return false;
+	}
+
+	return true;
+}
+
+static void _xopt_batch_layout(size_t count, const int *argc,
+		const char **extras, xoptResult *results) {
+	size_t i;
+
+	/* lay the extras out back to back; each command line gets room for as
+		 many extras as it has arguments (plus the terminator), so nothing can
+		 overflow and the layout doesn't depend on parse order */
+	for (i = 0; i < count; i++) {
+		results[i].extras = extras;
+		extras += argc[i] + 1;
+	}
+}
+
+static size_t _xopt_parse_batch_range(const xoptContext *ctx, size_t begin,
+		size_t end, const int *argc, const char ***argv, void *data,
+		size_t stride, xoptResult *results) {
+	struct _xoptState state;
+	size_t failed = 0;
+	size_t i;
+
+	/* everything but the per-line pointers is set up once for the range */
+	state.extrasFixed = true;
+	state.extrasCallback = 0;
+
+	for (i = begin; i < end; i++) {
+		state.extrasCapac = argc[i] + 1;
+		state.data = (char*) data + i * stride;
+		state.result = &results[i];
+		results[i].ownsExtras = false;
+
+		if (!_xopt_parse(&state, ctx, argc[i], argv[i])) {
+			++failed;
+		}
+	}
+
+	return failed;
+}
+
+#ifndef XOPT_NOTHREADS
+static void *_xopt_batch_worker(void *arg) {
+	struct _xoptBatchWorker *worker = arg;
+	struct _xoptBatchJob *job = worker->job;
+	size_t begin, end;
+
+	for (;;) {
+		if (!_xopt_batch_take(worker, &begin, &end) &&
+				!(_xopt_batch_steal(worker) &&
+					_xopt_batch_take(worker, &begin, &end))) {
+			break;
+		}
+
+		worker->failed += _xopt_parse_batch_range(job->ctx, begin, end,
+				job->argc, job->argv, job->data, job->stride, job->results);
+	}
+
+	return 0;
+}
+
+static bool _xopt_batch_take(struct _xoptBatchWorker *worker, size_t *begin,
+		size_t *end) {
+	bool found;
+
+	pthread_mutex_lock(&worker->lock);
+	found = worker->next < worker->end;
+	if (found) {
+		*begin = worker->next;
+		*end = worker->end - worker->next > BATCH_CHUNK
+			? worker->next + BATCH_CHUNK
+			: worker->end;
+		worker->next = *end;
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	return found;
+}
+
+static bool _xopt_batch_steal(struct _xoptBatchWorker *worker) {
+	struct _xoptBatchJob *job = worker->job;
+	unsigned self = (unsigned) (worker - job->workers);
+	unsigned i;
+
+	/* try everybody else, starting with our neighbour */
+	for (i = 1; i < job->threads; i++) {
+		struct _xoptBatchWorker *victim =
+			&job->workers[(self + i) % job->threads];
+		size_t begin = 0, end = 0;
+
+		pthread_mutex_lock(&victim->lock);
+		if (victim->next < victim->end) {
+			end = victim->end;
+			begin = end - (end - victim->next + 1) / 2;
+			victim->end = begin;
+		}
+		pthread_mutex_unlock(&victim->lock);
+
+		if (begin < end) {
+			pthread_mutex_lock(&worker->lock);
+			worker->next = begin;
+			worker->end = end;
+			pthread_mutex_unlock(&worker->lock);
+			return true;
+		}
+	}
+
+	return false;
+}
+#endif
+
+static int _xopt_next_short(xoptIterator *it, const xoptOption **option,
+		const char **value) {
+	const char *arg = it->group++;
+	int argRequirement;
+
+	/* is this the last in the set of condensed options? */
+	bool last = !*it->group;
+	if (last) {
+		it->group = 0;
+	}
+
+	/* get argument or error if not found and strict mode enabled. */
+	argRequirement = _xopt_get_arg(it->ctx, arg, 1, 1, option);
+	if (!*option) {
+		it->group = 0;
+		if (it->ctx->flags & XOPT_CTX_STRICT) {
+			_xopt_set_err(it, XOPT_ERR_INVALID, it->groupArgi, arg, 0, false);
+			return XOPT_NEXT_ERROR;
+		}
+
+		/* skip the rest of the set */
+		return XOPT_NEXT_END;
+	}
+
+	it->longArg = false;
+
+	switch (argRequirement) {
+	case 1: /* argument is optional */
+		/* is there another argument, and is it a non-option? */
+		if (it->argi + 1 < it->argc && _xopt_get_size(it->argv[it->argi + 1]) == 0) {
+			*value = it->argv[++it->argi];
+		}
+		break;
+	case 2: /* requires an argument */
+		if (!last) {
+			_xopt_set_err(it, XOPT_ERR_NOT_LAST, it->groupArgi, arg, *option, false);
+			return XOPT_NEXT_ERROR;
+		}
+
+		/* is there another argument, and is it a non-option?
+			 an option indicates no value was passed */
+		if (it->argi + 1 < it->argc && _xopt_get_size(it->argv[it->argi + 1]) == 0) {
+			*value = it->argv[++it->argi];
+		} else {
+			_xopt_set_err(it, XOPT_ERR_MISSING_VALUE, it->groupArgi, arg, *option,
+					false);
+			return XOPT_NEXT_ERROR;
+		}
+		break;
+	}
+
+	return XOPT_NEXT_OPTION;
+}
+
+static int _xopt_next_long(xoptIterator *it, const char *arg,
+		const xoptOption **option, const char **value) {
+	const char *valStart;
+	size_t length;
+	int argRequirement;
+
+	it->longArg = true;
+
+	/* find first equals sign */
+	valStart = strchr(arg, '=');
+
+	/* is there a value? */
+	if (valStart) {
+		/* we also increase valStart here in order to lop off
+			 the equals sign */
+		length = valStart++ - arg;
+
+		/* but not really, if it's null */
+		if (!*valStart) {
+			valStart = 0;
+		}
+	} else {
+		length = strlen(arg);
+	}
+
+	/* get the option; failing that, --no-<name> turns off a boolean that's
+		 left to the default handler (an option actually named no-<name> has
+		 already been found by then) */
+	argRequirement = _xopt_get_arg(it->ctx, arg, length, 2, option);
+	if (!*option && length > 3 && !memcmp(arg, "no-", 3)) {
+		argRequirement = _xopt_get_arg(it->ctx, arg + 3, length - 3, 2, option);
+		if (*option && _xopt_negatable(it->ctx, *option)) {
+			it->negated = true;
+		} else {
+			*option = 0;
+		}
+	}
+
+	if (!*option) {
+		_xopt_set_err(it, XOPT_ERR_INVALID, it->argi, arg, 0, true);
+		return XOPT_NEXT_ERROR;
+	}
+
+	switch (argRequirement) {
+	case 0: /* flag; doesn't take an argument */
+		if (valStart) {
+			_xopt_set_err(it, XOPT_ERR_UNEXPECTED_VALUE, it->argi, arg, *option,
+					true);
+			return XOPT_NEXT_ERROR;
+		}
+		break;
+	case 2: /* requires an argument */
+		if (!valStart) {
+			_xopt_set_err(it, XOPT_ERR_MISSING_VALUE, it->argi, arg, *option, true);
+			return XOPT_NEXT_ERROR;
+		}
+		break;
+	}
+
+	*value = valStart;
+	return XOPT_NEXT_OPTION;
+}
+
+static void _xopt_push_extra(struct _xoptState *state, const char *extra) {
+	xoptResult *result = state->result;
+
+	/* hand extras straight to the callback, if there is one */
+	if (state->extrasCallback) {
+		if (extra) {
+			const char *err = 0;
+			state->extrasCallback(extra, state->it.argi, state->extrasData, &err);
+			if (err) {
+				_xopt_set_err(&state->it, XOPT_ERR_CALLBACK, state->it.argi, extra, 0,
+						false);
+				state->it.error.message = err;
+				return;
+			}
+		}
+
+		++result->extrasCount;
+		return;
+	}
+
+	/* have we hit the list size limit? */
+	if ((size_t) result->extrasCount >= state->extrasCapac) {
+		const char **extras;
+
+		/* a fixed buffer isn't grown; the extra is still counted so that the
+			 required size can be reported */
+		if (state->extrasFixed) {
+			++result->extrasCount;
+			return;
+		}
+
+		/* double capacity (keeping appends amortized O(1) for huge command
+			 lines), realloc, and check for success */
+		state->extrasCapac *= 2;
+		extras = realloc(result->extras, sizeof(*extras) * state->extrasCapac);
+		if (!extras) {
+			_xopt_set_err(&state->it, XOPT_ERR_NOMEM, state->it.argi, 0, 0, false);
+			state->it.error.message = "could not realloc arguments array";
+			return;
+		}
+
+		result->extras = extras;
+	}
+
+	result->extras[result->extrasCount++] = extra;
+}
+
+static int _xopt_get_size(const char *arg) {
+	int size;
+	for (size = 0; size < 2; size++) {
+		if (arg[size] != '-') {
+			break;
+		}
+	}
+	return size;
+}
+
+static int _xopt_get_arg(const xoptContext *ctx, const char *arg, size_t len,
+		int size, const xoptOption **option) {
+	const xoptOption *options = ctx->options;
+	*option = 0;
+
+	/* find the argument */
+	if (size == 1) {
+		if (_XOPT_SHORT_VALID(ctx, arg[0])) {
+			*option = &options[ctx->shortIndex[(unsigned char) arg[0]]];
+		}
+	} else {
+		const struct _xoptLongSlot *slot;
+		unsigned long hash = _xopt_hash(arg, len);
+		size_t i;
+
+		/* probe the long option index; comparing hashes and lengths first
+			 means a name is only compared once it's almost certainly a match */
+		for (i = hash & ctx->longMask;; i = (i + 1) & ctx->longMask) {
+			slot = &ctx->longSlots[i];
+			if (slot->index == -1) {
+				break;
+			}
+
+			if (slot->hash == hash && slot->length == len &&
+					!memcmp(options[slot->index].longArg, arg, len)) {
+				*option = &options[slot->index];
+				break;
+			}
+		}
+	}
+
+	return _xopt_arg_kind(*option);
+}
+
+static int _xopt_arg_kind(const xoptOption *option) {
+	/* determine the optionality of a value */
+	if (!option || option->options & (XOPT_TYPE_BOOL | XOPT_TYPE_COUNTER)) {
+		return 0;
+	} else if (option->options & XOPT_OPTIONAL) {
+		return 1;
+	} else {
+		return 2;
+	}
+}
+
+static bool _xopt_negatable(const xoptContext *ctx,
+		const xoptOption *option) {
+	/* whether --no-<name> turns the option off: booleans that are left to
+		 the default handler, unless an option is actually named no-<name> */
+	int i;
+
+	if (!option->longArg || option->callback
+			|| (option->options & TYPE_MASK) != XOPT_TYPE_BOOL) {
+		return false;
+	}
+
+	for (i = 0; i < ctx->count; i++) {
+		const char *name = ctx->options[i].longArg;
+		if (name && !strncmp(name, "no-", 3)
+				&& !strcmp(name + 3, option->longArg)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static unsigned long _xopt_hash(const char *str, size_t len) {
+	/* 32-bit FNV-1a */
+	unsigned long hash = 2166136261UL;
+	while (len--) {
+		hash ^= (unsigned char) *str++;
+		hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+	}
+	return hash;
+}
+
+static void _xopt_choice_size(const xoptOption *option, size_t *buckets,
+		size_t *slots) {
+	/* at most half of the slots are used, with two names per bucket on
+		 average; displacements are easy to find at that density */
+	size_t n;
+
+	for (n = 0; option->choices[n].name; n++);
+	for (*slots = 2; *slots < n * 2; *slots <<= 1);
+	for (*buckets = 1; *buckets * 2 < n; *buckets <<= 1);
+}
+
+static void _xopt_choice_build(struct _xoptChoiceIndex *index,
+		const xoptChoice *choices) {
+	/* hash and displace: names are grouped into buckets by hash, and the
+		 biggest buckets are placed first, each trying displacements until all
+		 of its names land in free slots */
+	size_t buckets = index->bucketMask + 1;
+	size_t slot, b;
+	uint32_t *hashes;
+	int *order, *start, *fill;
+	int n, i, k, end, size, maxSize;
+	unsigned displace;
+
+	for (slot = 0; slot <= index->slotMask; slot++) {
+		index->slots[slot] = -1;
+	}
+	memset(index->displace, 0, sizeof(*index->displace) * buckets);
+	index->linear = false;
+
+	for (n = 0; choices[n].name; n++);
+	if (!n) {
+		return;
+	}
+
+	/* scratch space; without it, fall back to scanning */
+	hashes = malloc(sizeof(*hashes) * n + sizeof(int) * (n + 2 * buckets + 1));
+	if (!hashes) {
+		index->linear = true;
+		return;
+	}
+
+	order = (int*) (hashes + n);
+	start = order + n;
+	fill = start + buckets + 1;
+
+	/* group the names by bucket (keeping their order within a bucket) */
+	memset(start, 0, sizeof(int) * (2 * buckets + 1));
+	for (i = 0; i < n; i++) {
+		hashes[i] = (uint32_t) _xopt_hash(choices[i].name, strlen(choices[i].name));
+		++start[(hashes[i] & index->bucketMask) + 1];
+	}
+
+	maxSize = 0;
+	for (b = 0; b < buckets; b++) {
+		if (start[b + 1] > maxSize) {
+			maxSize = start[b + 1];
+		}
+		start[b + 1] += start[b];
+	}
+
+	for (i = 0; i < n; i++) {
+		b = hashes[i] & index->bucketMask;
+		order[start[b] + fill[b]++] = i;
+	}
+
+	for (size = maxSize; size > 0; size--) {
+		for (b = 0; b < buckets; b++) {
+			if (start[b + 1] - start[b] != size) {
+				continue;
+			}
+
+			end = start[b + 1];
+
+			/* duplicate names can't be told apart; the first one wins */
+			for (i = start[b]; i < end; i++) {
+				for (k = start[b]; k < i; k++) {
+					if (order[k] >= 0 &&
+							!strcmp(choices[order[k]].name, choices[order[i]].name)) {
+						order[i] = -1;
+						break;
+					}
+				}
+			}
+
+			for (displace = 0; displace <= 0xFFFF; displace++) {
+				for (k = start[b]; k < end; k++) {
+					if (order[k] < 0) {
+						continue;
+					}
+
+					slot = _xopt_choice_mix(hashes[order[k]], displace)
+						& index->slotMask;
+					if (index->slots[slot] != -1) {
+						break;
+					}
+					index->slots[slot] = order[k];
+				}
+
+				if (k == end) {
+					index->displace[b] = (unsigned short) displace;
+					break;
+				}
+
+				/* take back what was placed with this displacement */
+				while (k-- > start[b]) {
+					if (order[k] >= 0) {
+						index->slots[_xopt_choice_mix(hashes[order[k]], displace)
+							& index->slotMask] = -1;
+					}
+				}
+			}
+
+			if (displace > 0xFFFF) {
+				/* names whose full hashes collide can't be separated */
+				index->linear = true;
+				free(hashes);
+				return;
+			}
+		}
+	}
+
+	free(hashes);
+}
+
+static uint32_t _xopt_choice_mix(uint32_t hash, unsigned displace) {
+	/* murmur3's finalizer, so every displacement gives unrelated slots */
+	hash ^= (uint32_t) displace * UINT32_C(0x9E3779B9);
+	hash ^= hash >> 16;
+	hash *= UINT32_C(0x85EBCA6B);
+	hash ^= hash >> 13;
+	hash *= UINT32_C(0xC2B2AE35);
+	hash ^= hash >> 16;
+	return hash;
+}
+
+static int _xopt_choice_find(const xoptContext *ctx, const xoptOption *option,
+		const char *name, size_t len) {
+	/* returns the index of the choice called `name', or -1 */
+	const struct _xoptChoiceIndex *index;
+	const xoptChoice *choices = option->choices;
+	uint32_t hash;
+	int i;
+
+	if (!choices) {
+		return -1;
+	}
+
+	index = &ctx->choiceIndex[option - ctx->options];
+	if (index->linear) {
+		for (i = 0; choices[i].name; i++) {
+			if (!strncmp(choices[i].name, name, len) && !choices[i].name[len]) {
+				return i;
+			}
+		}
+
+		return -1;
+	}
+
+	hash = (uint32_t) _xopt_hash(name, len);
+	i = index->slots[_xopt_choice_mix(hash,
+			index->displace[hash & index->bucketMask]) & index->slotMask];
+
+	return i >= 0 && !strncmp(choices[i].name, name, len) && !choices[i].name[len]
+		? i
+		: -1;
+}
+
+static void _xopt_set(struct _xoptState *state, const xoptOption *option,
+		const char *val, bool longArg) {
+	const char *err = 0;
+
+	/* no callback means the built-in handler */
+	if (!option->callback) {
+		_xopt_default_callback(state, val, option, longArg);
+		return;
+	}
+
+	/* dispatch callback, recording any error it reports */
+	option->callback(val, state->data, option, longArg, &err);
+	if (err) {
+		_xopt_set_err(&state->it, XOPT_ERR_CALLBACK, state->it.argi, val, option,
+				longArg);
+		state->it.error.message = err;
+	}
+}
+
+static void _xopt_default_callback(struct _xoptState *state, const char *value,
+		const xoptOption *option, bool longArg) {
+	void *target;
+	const char *at = value;
+	int code = XOPT_ERR_NONE;
+	int choice;
+
+	/* is a value specified? */
+	if ((!value || !strlen(value)) &&
+			!(option->options & (XOPT_TYPE_BOOL | XOPT_TYPE_COUNTER))) {
+		/* we reach this point when they specified an optional, non-boolean
+			 option but didn't specify a custom handler (therefore, it's not
+			 optional).
+
+			 to fix, just remove the optional flag or specify a callback to handle
+			 it yourself.
+			 */
+		return;
+	}
+
+	/* get location; a repeated option's value goes at the end of the values
+		 accumulated so far instead (lists reserve their own room) */
+	target = ((char*) state->data) + option->offset;
+	if ((option->options & XOPT_REPEAT) && !(option->options & LIST_MASK)) {
+		/* xopt_context() made sure the type can be repeated */
+		target = _xopt_repeat_reserve(state, option,
+				_xopt_repeat_width(option->options & TYPE_MASK), 1);
+		if (!target) {
+			code = XOPT_ERR_NOMEM;
+			goto error;
+		}
+	}
+
+	/* switch on the type */
+	switch (option->options & TYPE_MASK) {
+	case XOPT_TYPE_BOOL:
+		/* booleans are special in that they won't have an argument passed
+			 into this callback */
+		*((_Bool*) target) = !state->it.negated;
+		break;
+	case XOPT_TYPE_COUNTER:
+		/* called once per occurrence, including each one in a group of
+			 condensed short options */
+		++*((int*) target);
+		break;
+	case XOPT_TYPE_STRING:
+		/* lifetime here works out fine; argv can usually be assumed static-like
+			 in nature */
+		*((const char**) target) = value;
+		break;
+	case XOPT_TYPE_INT:
+	case XOPT_TYPE_LONG:
+	case XOPT_TYPE_INT32:
+	case XOPT_TYPE_INT64:
+	case XOPT_TYPE_UINT32:
+	case XOPT_TYPE_UINT64:
+		code = _xopt_set_int(value, strlen(value), option->options & TYPE_MASK,
+				target);
+		break;
+	case XOPT_TYPE_FLOAT:
+	case XOPT_TYPE_DOUBLE:
+		code = _xopt_parse_float(value, strlen(value),
+				(option->options & TYPE_MASK) == XOPT_TYPE_FLOAT, target);
+		break;
+	case XOPT_TYPE_INT32_LIST:
+	case XOPT_TYPE_INT64_LIST:
+	case XOPT_TYPE_DOUBLE_LIST:
+		code = _xopt_set_list(state, value, option, &at);
+		break;
+	case XOPT_TYPE_ENUM:
+		choice = _xopt_choice_find(state->it.ctx, option, value, strlen(value));
+		if (choice < 0) {
+			code = XOPT_ERR_CHOICE;
+		} else {
+			*((int*) target) = option->choices[choice].value;
+		}
+		break;
+	case XOPT_TYPE_FLAGS:
+		code = _xopt_set_flags(state, value, option, target, &at);
+		break;
+	case XOPT_TYPE_MAP:
+		code = _xopt_set_map(state, value, option);
+		break;
+	case XOPT_TYPE_SIZE:
+		code = _xopt_set_size(value, target);
+		break;
+	case XOPT_TYPE_DURATION:
+		code = _xopt_set_duration(value, target);
+		break;
+	default: /* something wonky, or the implementation specifies two types */
+		fprintf(stderr, "warning: XOpt argument type invalid: %ld\n",
+			option->options & TYPE_MASK);
+		break;
+	}
+
+error:
+	if (code) {
+		_xopt_set_err(&state->it, code, state->it.argi, at, option, longArg);
+		if (code == XOPT_ERR_NOMEM) {
+			state->it.error.message = "could not allocate option values";
+		}
+	}
+}
+
+static int _xopt_set_int(const char *value, size_t len, long type,
+		void *target) {
+	uint64_t magnitude, maxPos, maxNeg;
+	int64_t signedValue;
+	bool negative;
+	int code;
+
+	/* limits of the target type; negative limits are magnitudes */
+	switch (type) {
+	case XOPT_TYPE_INT:
+		maxPos = INT_MAX;
+		maxNeg = (uint64_t) -(INT_MIN + 1) + 1;
+		break;
+	case XOPT_TYPE_LONG:
+		maxPos = LONG_MAX;
+		maxNeg = (uint64_t) -(LONG_MIN + 1) + 1;
+		break;
+	case XOPT_TYPE_INT32:
+		maxPos = INT32_MAX;
+		maxNeg = (uint64_t) INT32_MAX + 1;
+		break;
+	case XOPT_TYPE_INT64:
+		maxPos = INT64_MAX;
+		maxNeg = (uint64_t) INT64_MAX + 1;
+		break;
+	case XOPT_TYPE_UINT32:
+		maxPos = UINT32_MAX;
+		maxNeg = 0;
+		break;
+	default:
+		maxPos = UINT64_MAX;
+		maxNeg = 0;
+		break;
+	}
+
+	code = _xopt_parse_int(value, len, maxPos, maxNeg, &negative, &magnitude);
+	if (code) {
+		return code;
+	}
+
+	/* negate without overflowing on the most negative value */
+	signedValue = negative && magnitude
+		? -(int64_t) (magnitude - 1) - 1
+		: (int64_t) magnitude;
+
+	switch (type) {
+	case XOPT_TYPE_INT:
+		*((int*) target) = (int) signedValue;
+		break;
+	case XOPT_TYPE_LONG:
+		*((long*) target) = (long) signedValue;
+		break;
+	case XOPT_TYPE_INT32:
+		*((int32_t*) target) = (int32_t) signedValue;
+		break;
+	case XOPT_TYPE_INT64:
+		*((int64_t*) target) = signedValue;
+		break;
+	case XOPT_TYPE_UINT32:
+		*((uint32_t*) target) = (uint32_t) magnitude;
+		break;
+	default:
+		*((uint64_t*) target) = magnitude;
+		break;
+	}
+
+	return XOPT_ERR_NONE;
+}
+
+static int _xopt_set_size(const char *value, uint64_t *target) {
+	/* a byte count, optionally scaled by an SI (k/K, M, G, T, P, E) or an IEC
+		 (Ki, Mi, ...) prefix, optionally followed by a B */
+	static const char prefixes[] = "kMGTPE";
+	const char *prefix;
+	uint64_t count, unit = 1, base = 1000;
+	int code, power;
+
+	code = _xopt_parse_decimal(&value, &count);
+	if (code) {
+		return code;
+	}
+
+	prefix = *value == 'K' ? prefixes : strchr(prefixes, *value);
+	if (*value && prefix) {
+		++value;
+		if (*value == 'i') {
+			base = 1024;
+			++value;
+		}
+
+		for (power = (int) (prefix - prefixes) + 1; power; power--) {
+			unit *= base;
+		}
+	}
+
+	if (*value == 'B') {
+		++value;
+	}
+
+	if (*value) {
+		return XOPT_ERR_NUMBER;
+	}
+
+	if (count > UINT64_MAX / unit) {
+		return XOPT_ERR_RANGE;
+	}
+
+	*target = count * unit;
+	return XOPT_ERR_NONE;
+}
+
+static int _xopt_set_duration(const char *value, uint64_t *target) {
+	/* nanoseconds: one or more integers, each with a unit (ns, us or UTF-8
+		 micro sign + s, ms, s, m, h), added up; only "0" may go without one */
+	uint64_t total = 0, count, unit;
+	int code;
+
+	if (!strcmp(value, "0")) {
+		*target = 0;
+		return XOPT_ERR_NONE;
+	}
+
+	do {
+		code = _xopt_parse_decimal(&value, &count);
+		if (code) {
+			return code;
+		}
+
+		if (!strncmp(value, "ns", 2)) {
+			unit = 1;
+			value += 2;
+		} else if (!strncmp(value, "us", 2)) {
+			unit = UINT64_C(1000);
+			value += 2;
+		} else if (!strncmp(value, "\xC2\xB5s", 3)) {
+			unit = UINT64_C(1000);
+			value += 3;
+		} else if (!strncmp(value, "ms", 2)) {
+			unit = UINT64_C(1000000);
+			value += 2;
+		} else if (*value == 's') {
+			unit = UINT64_C(1000000000);
+			++value;
+		} else if (*value == 'm') {
+			unit = UINT64_C(60000000000);
+			++value;
+		} else if (*value == 'h') {
+			unit = UINT64_C(3600000000000);
+			++value;
+		} else {
+			return XOPT_ERR_NUMBER;
+		}
+
+		if (count > (UINT64_MAX - total) / unit) {
+			return XOPT_ERR_RANGE;
+		}
+
+		total += count * unit;
+	} while (*value);
+
+	*target = total;
+	return XOPT_ERR_NONE;
+}
+
+static int _xopt_parse_decimal(const char **str, uint64_t *value) {
+	/* parses the (non-empty) run of decimal digits at `*str' and moves past
+		 it */
+	const char *s = *str;
+	uint64_t acc = 0;
+	unsigned digit;
+
+	if (*s < '0' || *s > '9') {
+		return XOPT_ERR_NUMBER;
+	}
+
+	for (; *s >= '0' && *s <= '9'; s++) {
+		digit = (unsigned) (*s - '0');
+		if (acc > (UINT64_MAX - digit) / 10) {
+			return XOPT_ERR_RANGE;
+		}
+		acc = acc * 10 + digit;
+	}
+
+	*str = s;
+	*value = acc;
+	return XOPT_ERR_NONE;
+}
+
+static int _xopt_set_list(struct _xoptState *state, const char *value,
+		const xoptOption *option, const char **at) {
+	/* splits the value on the delimiter and parses every element into one
+		 array, sized up front by counting delimiters (or onto the end of the
+		 accumulated values, for a repeated list). like repeated values, the
+		 span is only handed out once the whole parse succeeds, since the
+		 array is released if it doesn't. */
+	long options = option->options;
+	char delim = _xopt_delim(options);
+	const char *end = value + strlen(value);
+	const char *next;
+	struct _xoptRepeat *repeat;
+	size_t count, width, i;
+	long type;
+	char *items;
+	int code;
+
+	switch (options & TYPE_MASK) {
+	case XOPT_TYPE_INT32_LIST:
+		type = XOPT_TYPE_INT32;
+		width = sizeof(int32_t);
+		break;
+	case XOPT_TYPE_INT64_LIST:
+		type = XOPT_TYPE_INT64;
+		width = sizeof(int64_t);
+		break;
+	default:
+		type = XOPT_TYPE_DOUBLE;
+		width = sizeof(double);
+		break;
+	}
+
+	count = _xopt_swar_count(value, end, delim) + 1;
+	items = options & XOPT_REPEAT
+		? _xopt_repeat_reserve(state, option, width, count)
+		: _xopt_arena_alloc(&state->result->arena, count * width);
+	if (!items) {
+		return XOPT_ERR_NOMEM;
+	}
+
+	for (i = 0; i < count; i++, value = next + (next < end)) {
+		next = _xopt_swar_find(value, end, delim);
+		code = type == XOPT_TYPE_DOUBLE
+			? _xopt_parse_float(value, next - value, false, items + i * width)
+			: _xopt_set_int(value, next - value, type, items + i * width);
+
+		if (code) {
+			/* point the error at the offending element */
+			*at = value;
+			return code;
+		}
+	}
+
+	if (options & XOPT_REPEAT) {
+		return XOPT_ERR_NONE;
+	}
+
+	/* otherwise the last list given wins */
+	repeat = _xopt_repeat_get(state, option);
+	if (!repeat) {
+		return XOPT_ERR_NOMEM;
+	}
+
+	repeat->items = items;
+	repeat->count = count;
+	return XOPT_ERR_NONE;
+}
+
+static int _xopt_set_flags(struct _xoptState *state, const char *value,
+		const xoptOption *option, uint64_t *target, const char **at) {
+	/* applies every name in the list to its bit, in order, on top of what's
+		 already there: a leading '-' clears the bit, '+' (or nothing) sets it */
+	char delim = _xopt_delim(option->options);
+	const char *end = value + strlen(value);
+	const char *next, *name;
+	unsigned bit;
+	int choice;
+	bool clear;
+
+	for (;; value = next + 1) {
+		next = _xopt_swar_find(value, end, delim);
+
+		name = value;
+		clear = false;
+		if (name < next && (*name == '-' || *name == '+')) {
+			clear = *name++ == '-';
+		}
+
+		choice = _xopt_choice_find(state->it.ctx, option, name, next - name);
+		if (choice < 0) {
+			*at = value;
+			return XOPT_ERR_CHOICE;
+		}
+
+		bit = (unsigned) option->choices[choice].value;
+		if (clear) {
+			target[bit >> 6] &= ~((uint64_t) 1 << (bit & 63));
+		} else {
+			target[bit >> 6] |= (uint64_t) 1 << (bit & 63);
+		}
+
+		if (next == end) {
+			return XOPT_ERR_NONE;
+		}
+	}
+}
+
+static int _xopt_set_map(struct _xoptState *state, const char *value,
+		const xoptOption *option) {
+	/* splits key=value on the first '=' (without copying either) and adds
+		 it to the option's map, minding the duplicate key policy; the map is
+		 handed out by _xopt_repeat_finish(), if the parse succeeds */
+	struct xoptArena **arena = &state->result->arena;
+	struct _xoptRepeat *repeat;
+	struct _xoptMapEntry *entry;
+	struct xoptMap *map;
+	const char *key = value;
+	const char *eq = strchr(value, '=');
+	size_t len = eq ? (size_t) (eq - value) : strlen(value);
+	unsigned long hash = _xopt_hash(value, len);
+	int i;
+
+	if (!len) {
+		return XOPT_ERR_VALUE;
+	}
+
+	repeat = _xopt_repeat_get(state, option);
+	if (!repeat) {
+		return XOPT_ERR_NOMEM;
+	}
+
+	map = repeat->map;
+	if (!map) {
+		map = _xopt_arena_alloc(arena, sizeof(*map));
+		if (!map) {
+			return XOPT_ERR_NOMEM;
+		}
+
+		map->entries = 0;
+		map->count = 0;
+		map->capacity = 0;
+		map->slots = 0;
+		map->slotMask = 0;
+		repeat->map = map;
+	}
+
+	/* a key without a value gets the empty string at its end */
+	value = eq ? eq + 1 : key + len;
+
+	i = _xopt_map_find(map, key, len, hash);
+	if (i >= 0) {
+		if (option->options & XOPT_MAP_UNIQUE) {
+			return XOPT_ERR_DUPLICATE;
+		}
+
+		if (!(option->options & XOPT_MAP_KEEPFIRST)) {
+			map->entries[i].value = value;
+		}
+
+		return XOPT_ERR_NONE;
+	}
+
+	/* keep the table at most half full, and the entries growing
+		 geometrically */
+	if (map->count == map->capacity) {
+		size_t capacity = map->capacity ? map->capacity * 2 : MAP_INIT;
+		entry = _xopt_arena_grow(arena, map->entries,
+				sizeof(*entry) * map->count, sizeof(*entry) * capacity);
+		if (!entry) {
+			return XOPT_ERR_NOMEM;
+		}
+
+		map->entries = entry;
+		map->capacity = capacity;
+	}
+
+	if (!map->slots || (map->count + 1) * 2 > map->slotMask + 1) {
+		if (!_xopt_map_rehash(map, arena,
+				map->slots ? (map->slotMask + 1) * 2 : MAP_INIT * 2)) {
+			return XOPT_ERR_NOMEM;
+		}
+	}
+
+	entry = &map->entries[map->count];
+	entry->key = key;
+	entry->keyLength = len;
+	entry->value = value;
+	entry->hash = hash;
+
+	for (i = (int) (hash & map->slotMask); map->slots[i] != -1;
+			i = (int) ((i + 1) & map->slotMask));
+	map->slots[i] = (int) map->count++;
+
+	return XOPT_ERR_NONE;
+}
+
+static int _xopt_map_find(const struct xoptMap *map, const char *key,
+		size_t len, unsigned long hash) {
+	/* returns the position of the entry for `key', or -1 */
+	const struct _xoptMapEntry *entry;
+	size_t i;
+
+	if (!map || !map->slots) {
+		return -1;
+	}
+
+	for (i = hash & map->slotMask; map->slots[i] != -1;
+			i = (i + 1) & map->slotMask) {
+		entry = &map->entries[map->slots[i]];
+		if (entry->hash == hash && entry->keyLength == len &&
+				!memcmp(entry->key, key, len)) {
+			return map->slots[i];
+		}
+	}
+
+	return -1;
+}
+
+static bool _xopt_map_rehash(struct xoptMap *map, struct xoptArena **arena,
+		size_t slots) {
+	/* moves the index to a new table of `slots' (a power of two) slots; the
+		 old one is simply left behind in the arena */
+	size_t i, j;
+	int *table = _xopt_arena_alloc(arena, sizeof(int) * slots);
+
+	if (!table) {
+		return false;
+	}
+
+	for (j = 0; j < slots; j++) {
+		table[j] = -1;
+	}
+
+	for (i = 0; i < map->count; i++) {
+		for (j = map->entries[i].hash & (slots - 1); table[j] != -1;
+				j = (j + 1) & (slots - 1));
+		table[j] = (int) i;
+	}
+
+	map->slots = table;
+	map->slotMask = slots - 1;
+	return true;
+}
+
+static char _xopt_delim(long options) {
+	char delim = (char) (options >> DELIM_SHIFT & 0x7F);
+	return delim ? delim : ',';
+}
+
+static size_t _xopt_repeat_width(long type) {
+	switch (type) {
+	case XOPT_TYPE_STRING:
+		return sizeof(const char*);
+	case XOPT_TYPE_INT32:
+	case XOPT_TYPE_INT32_LIST:
+		return sizeof(int32_t);
+	case XOPT_TYPE_INT64:
+	case XOPT_TYPE_INT64_LIST:
+		return sizeof(int64_t);
+	case XOPT_TYPE_DOUBLE:
+	case XOPT_TYPE_DOUBLE_LIST:
+		return sizeof(double);
+	default:
+		return 0;
+	}
+}
+
+static struct _xoptRepeat *_xopt_repeat_get(struct _xoptState *state,
+		const xoptOption *option) {
+	/* the per-parse record of an option, allocated for all options the first
+		 time any of them needs one */
+	const xoptContext *ctx = state->it.ctx;
+
+	if (!state->repeats) {
+		state->repeats = _xopt_arena_alloc(&state->result->arena,
+				sizeof(*state->repeats) * ctx->count);
+		if (!state->repeats) {
+			return 0;
+		}
+
+		memset(state->repeats, 0, sizeof(*state->repeats) * ctx->count);
+	}
+
+	return &state->repeats[option - ctx->options];
+}
+
+static void *_xopt_repeat_reserve(struct _xoptState *state,
+		const xoptOption *option, size_t width, size_t count) {
+	/* makes room for `count' more values of a repeated option, doubling its
+		 capacity as needed, and returns the first of them */
+	struct xoptArena **arena = &state->result->arena;
+	struct _xoptRepeat *repeat;
+	size_t capacity;
+	char *items;
+
+	repeat = _xopt_repeat_get(state, option);
+	if (!repeat) {
+		return 0;
+	}
+
+	if (repeat->capacity - repeat->count < count) {
+		capacity = repeat->capacity ? repeat->capacity * 2 : 8;
+		while (capacity - repeat->count < count) {
+			capacity *= 2;
+		}
+
+		items = _xopt_arena_grow(arena, repeat->items, repeat->count * width,
+				capacity * width);
+		if (!items) {
+			return 0;
+		}
+
+		repeat->items = items;
+		repeat->capacity = capacity;
+	}
+
+	items = repeat->items + repeat->count * width;
+	repeat->count += count;
+	return items;
+}
+
+static void _xopt_repeat_finish(struct _xoptState *state) {
+	/* writes the span of every repeated or list option that was given, and
+		 the map of every map option */
+	const xoptContext *ctx = state->it.ctx;
+	const xoptOption *option;
+	struct _xoptRepeat *repeat;
+	void *target;
+	int i;
+
+	if (!state->repeats) {
+		return;
+	}
+
+	for (i = 0; i < ctx->count; i++) {
+		option = &ctx->options[i];
+		repeat = &state->repeats[i];
+		target = ((char*) state->data) + option->offset;
+		if (repeat->map) {
+			*((xoptMap**) target) = repeat->map;
+			continue;
+		}
+
+		if (!repeat->count) {
+			continue;
+		}
+
+		switch (option->options & TYPE_MASK) {
+		case XOPT_TYPE_STRING:
+			((xoptStringList*) target)->items = (const char**) repeat->items;
+			((xoptStringList*) target)->count = repeat->count;
+			break;
+		case XOPT_TYPE_INT32:
+		case XOPT_TYPE_INT32_LIST:
+			((xoptInt32List*) target)->items = (int32_t*) repeat->items;
+			((xoptInt32List*) target)->count = repeat->count;
+			break;
+		case XOPT_TYPE_INT64:
+		case XOPT_TYPE_INT64_LIST:
+			((xoptInt64List*) target)->items = (int64_t*) repeat->items;
+			((xoptInt64List*) target)->count = repeat->count;
+			break;
+		default:
+			((xoptDoubleList*) target)->items = (double*) repeat->items;
+			((xoptDoubleList*) target)->count = repeat->count;
+			break;
+		}
+	}
+}
+
+static int _xopt_parse_int(const char *str, size_t len, uint64_t maxPos,
+		uint64_t maxNeg, bool *negative, uint64_t *magnitude) {
+	/* parses [+-] followed by a decimal, 0x-prefixed hex or 0-prefixed octal
+		 integer spanning exactly `len' bytes (like strtol with a base of 0, but
+		 without whitespace skipping or locale lookups), and checks it against
+		 the given limits without ever overflowing */
+	const char *end = str + len;
+	uint64_t acc = 0;
+	bool overflow = false;
+	unsigned digit;
+
+	*negative = false;
+	if (str < end && (*str == '-' || *str == '+')) {
+		*negative = *str++ == '-';
+	}
+
+	if (str == end) {
+		return XOPT_ERR_NUMBER;
+	}
+
+	if (end - str > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+		for (str += 2; str < end; str++) {
+			if (*str >= '0' && *str <= '9') {
+				digit = *str - '0';
+			} else if ((*str | 0x20) >= 'a' && (*str | 0x20) <= 'f') {
+				digit = (*str | 0x20) - 'a' + 10;
+			} else {
+				return XOPT_ERR_NUMBER;
+			}
+
+			overflow |= (acc >> 60) != 0;
+			acc = acc << 4 | digit;
+		}
+	} else if (str[0] == '0') {
+		for (++str; str < end; str++) {
+			if (*str < '0' || *str > '7') {
+				return XOPT_ERR_NUMBER;
+			}
+
+			overflow |= (acc >> 61) != 0;
+			acc = acc << 3 | (unsigned) (*str - '0');
+		}
+	} else {
+		/* decimal, eight digits at a time while we can */
+		uint32_t chunk;
+		while (end - str >= 8 && _xopt_swar_digits8(str, &chunk)) {
+			overflow |= acc > (UINT64_MAX - chunk) / 100000000;
+			acc = acc * 100000000 + chunk;
+			str += 8;
+		}
+
+		for (; str < end; str++) {
+			if (*str < '0' || *str > '9') {
+				return XOPT_ERR_NUMBER;
+			}
+
+			digit = *str - '0';
+			overflow |= acc > (UINT64_MAX - digit) / 10;
+			acc = acc * 10 + digit;
+		}
+	}
+
+	*magnitude = acc;
+	if (overflow || acc > (*negative ? maxNeg : maxPos)) {
+		return XOPT_ERR_RANGE;
+	}
+
+	return XOPT_ERR_NONE;
+}
+
+static bool _xopt_swar_digits8(const char *str, uint32_t *value) {
+	/* SWAR: checks and converts eight ASCII digits held in one 64-bit word */
+	uint64_t word = _xopt_load8(str);
+
+	/* every byte must be 0x30-0x39: the high nibble must be 3, and adding 6
+		 mustn't carry out of the low nibble */
+	if (((word & UINT64_C(0xF0F0F0F0F0F0F0F0)) |
+			(((word + UINT64_C(0x0606060606060606)) & UINT64_C(0xF0F0F0F0F0F0F0F0))
+				>> 4)) != UINT64_C(0x3333333333333333)) {
+		return false;
+	}
+
+	/* combine pairs, then quads, then the two halves */
+	word -= UINT64_C(0x3030303030303030);
+	word = (word * 10) + (word >> 8);
+	word = (((word & UINT64_C(0x000000FF000000FF)) * UINT64_C(0x000F424000000064)) +
+			(((word >> 16) & UINT64_C(0x000000FF000000FF)) *
+				UINT64_C(0x0000271000000001))) >> 32;
+
+	*value = (uint32_t) word;
+	return true;
+}
+
+
+static uint64_t _xopt_load8(const char *str) {
+	/* eight bytes as one word, assembled little-endian regardless of the
+		 platform's byte order (compilers turn this into a single load) */
+	const unsigned char *s = (const unsigned char *) str;
+	return
+		(uint64_t) s[0]       | (uint64_t) s[1] << 8  |
+		(uint64_t) s[2] << 16 | (uint64_t) s[3] << 24 |
+		(uint64_t) s[4] << 32 | (uint64_t) s[5] << 40 |
+		(uint64_t) s[6] << 48 | (uint64_t) s[7] << 56;
+}
+
+static const char *_xopt_swar_find(const char *str, const char *end, char c) {
+	/* SWAR: skips eight bytes at a time while none of them is `c' (a byte of
+		 word ^ pattern is zero exactly where `c' is) */
+	uint64_t pattern = UINT64_C(0x0101010101010101) * (unsigned char) c;
+	uint64_t word;
+
+	for (; end - str >= 8; str += 8) {
+		word = _xopt_load8(str) ^ pattern;
+		if ((word - UINT64_C(0x0101010101010101)) & ~word
+				& UINT64_C(0x8080808080808080)) {
+			break;
+		}
+	}
+
+	for (; str < end && *str != c; str++);
+	return str;
+}
+
+static size_t _xopt_swar_count(const char *str, const char *end, char c) {
+	/* SWAR: counts `c' eight bytes at a time; after the or, the high bit of
+		 each byte is clear exactly where word ^ pattern had a zero byte */
+	uint64_t pattern = UINT64_C(0x0101010101010101) * (unsigned char) c;
+	uint64_t low7 = UINT64_C(0x7F7F7F7F7F7F7F7F);
+	uint64_t word;
+	size_t count = 0;
+
+	for (; end - str >= 8; str += 8) {
+		word = _xopt_load8(str) ^ pattern;
+		word = ~(((word & low7) + low7) | word) & UINT64_C(0x8080808080808080);
+		count += (size_t) (((word >> 7) * UINT64_C(0x0101010101010101)) >> 56);
+	}
+
+	for (; str < end; str++) {
+		count += *str == c;
+	}
+
+	return count;
+}
+
+static void *_xopt_arena_alloc(struct xoptArena **arena, size_t size) {
+	struct xoptArena *block = *arena;
+	size_t blockSize;
+
+	size = ALIGN_UP(size);
+	if (!block || block->size - block->used < size) {
+		/* blocks double in size; anything bigger gets a block of its own */
+		blockSize = block ? block->size * 2 : ARENA_BLOCK;
+		if (blockSize < size) {
+			blockSize = size;
+		}
+
+		block = malloc(ALIGN_UP(sizeof(struct xoptArena)) + blockSize);
+		if (!block) {
+			return 0;
+		}
+
+		block->next = *arena;
+		block->size = blockSize;
+		block->used = 0;
+		*arena = block;
+	}
+
+	block->last = block->used;
+	block->used += size;
+	return ARENA_DATA(block) + block->last;
+}
+
+static void *_xopt_arena_grow(struct xoptArena **arena, void *ptr,
+		size_t oldSize, size_t size) {
+	struct xoptArena *block = *arena;
+	void *grown;
+
+	/* the newest allocation can be extended in place while its block has
+		 room; anything else moves */
+	if (ptr && (char*) ptr == ARENA_DATA(block) + block->last &&
+			block->size - block->last >= ALIGN_UP(size)) {
+		block->used = block->last + ALIGN_UP(size);
+		return ptr;
+	}
+
+	grown = _xopt_arena_alloc(arena, size);
+	if (grown && oldSize) {
+		memcpy(grown, ptr, oldSize);
+	}
+
+	return grown;
+}
+
+static void _xopt_arena_free(struct xoptArena *arena) {
+	struct xoptArena *next;
+
+	for (; arena; arena = next) {
+		next = arena->next;
+		free(arena);
+	}
+}
+
+static int _xopt_parse_float(const char *str, size_t len, bool single,
+		void *target) {
+	/* parses [+-] followed by a decimal number (digits with an optional point
+		 and exponent), "inf", "infinity" or "nan" spanning exactly `len' bytes,
+		 correctly rounded and without any locale lookups. hexadecimal floats
+		 aren't supported. */
+	const struct _xoptFloatFormat *fmt = single
+		? &_xopt_float_format
+		: &_xopt_double_format;
+	const char *end = str + len;
+	const char *number;
+	struct _xoptDecimal decimal;
+	uint64_t w = 0, bits, infinity;
+	uint32_t chunk, bits32;
+	long exp10 = 0, exp = 0;
+	int significant = 0;
+	bool negative = false, truncated = false, digits = false;
+	bool expNegative = false;
+	double d;
+	float f;
+
+	infinity = (uint64_t) ((1 << fmt->exponentBits) - 1) << fmt->mantissaBits;
+
+	if (str < end && (*str == '-' || *str == '+')) {
+		negative = *str++ == '-';
+	}
+
+	number = str;
+
+	if (_xopt_match_word(str, end, "inf")
+			|| _xopt_match_word(str, end, "infinity")) {
+		bits = infinity;
+	} else if (_xopt_match_word(str, end, "nan")) {
+		bits = infinity | (uint64_t) 1 << (fmt->mantissaBits - 1);
+	} else {
+		/* keep the first 19 significant digits in w (so it can't overflow),
+			 and just note whether any of the rest weren't zero */
+		for (; str < end && *str == '0'; str++) {
+			digits = true;
+		}
+
+		while (end - str >= 8 && significant <= 11
+				&& _xopt_swar_digits8(str, &chunk)) {
+			w = w * 100000000 + chunk;
+			significant += 8;
+			digits = true;
+			str += 8;
+		}
+
+		for (; str < end && *str >= '0' && *str <= '9'; str++) {
+			if (significant < 19) {
+				w = w * 10 + (unsigned) (*str - '0');
+				++significant;
+			} else {
+				truncated |= *str != '0';
+				++exp10;
+			}
+			digits = true;
+		}
+
+		if (str < end && *str == '.') {
+			++str;
+
+			if (!w) {
+				for (; str < end && *str == '0'; str++) {
+					--exp10;
+					digits = true;
+				}
+			}
+
+			while (end - str >= 8 && significant <= 11
+					&& _xopt_swar_digits8(str, &chunk)) {
+				w = w * 100000000 + chunk;
+				significant += 8;
+				exp10 -= 8;
+				digits = true;
+				str += 8;
+			}
+
+			for (; str < end && *str >= '0' && *str <= '9'; str++) {
+				if (significant < 19) {
+					w = w * 10 + (unsigned) (*str - '0');
+					++significant;
+					--exp10;
+				} else {
+					truncated |= *str != '0';
+				}
+				digits = true;
+			}
+		}
+
+		if (!digits) {
+			return XOPT_ERR_NUMBER;
+		}
+
+		if (str < end && (*str == 'e' || *str == 'E')) {
+			++str;
+			if (str < end && (*str == '-' || *str == '+')) {
+				expNegative = *str++ == '-';
+			}
+
+			if (str == end || *str < '0' || *str > '9') {
+				return XOPT_ERR_NUMBER;
+			}
+
+			/* anything this large is zero or infinity anyway */
+			for (; str < end && *str >= '0' && *str <= '9'; str++) {
+				if (exp < 100000) {
+					exp = exp * 10 + (*str - '0');
+				}
+			}
+
+			exp10 += expNegative ? -exp : exp;
+		}
+
+		if (str != end) {
+			return XOPT_ERR_NUMBER;
+		}
+
+		bits = _xopt_eisel_lemire(w, exp10, fmt);
+
+		/* the digits we dropped put the real value between w and w + 1 (times
+			 10^exp10); if those round differently, do it the slow way */
+		if (truncated && bits != _xopt_eisel_lemire(w + 1, exp10, fmt)) {
+			_xopt_decimal_read(&decimal, number, end);
+			bits = _xopt_decimal_bits(&decimal, fmt);
+		}
+
+		if (bits == infinity) {
+			return XOPT_ERR_RANGE;
+		}
+	}
+
+	if (negative) {
+		bits |= (uint64_t) 1 << (fmt->mantissaBits + fmt->exponentBits);
+	}
+
+	if (single) {
+		bits32 = (uint32_t) bits;
+		memcpy(&f, &bits32, sizeof(f));
+		*((float*) target) = f;
+	} else {
+		memcpy(&d, &bits, sizeof(d));
+		*((double*) target) = d;
+	}
+
+	return XOPT_ERR_NONE;
+}
+
+static bool _xopt_match_word(const char *str, const char *end,
+		const char *word) {
+	/* case-insensitive, ASCII-only comparison of the whole span */
+	for (; str < end && *word; str++, word++) {
+		if ((*str | 0x20) != *word) {
+			return false;
+		}
+	}
+
+	return str == end && !*word;
+}
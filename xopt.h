@@ -27,8 +27,11 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 struct xoptOption;
+struct xoptArena;
+struct xoptMap;
 
 #ifndef offsetof
 #	define offsetof(T, member) (size_t)(&(((T*)0)->member))
@@ -47,18 +50,79 @@ typedef void (*xoptCallback)(
 	                                             was used */
 	const char              **err);           /* err output */
 
+/**
+ * Callback type for streaming extras.
+ *  Called by xopt_parse_cb() for each non-option
+ *  argument, as soon as it's found.
+ */
+typedef void (*xoptExtraCallback)(
+	const char              *extra,           /* the extra argument */
+	int                     argi,             /* its index in argv */
+	void                    *callbackData,    /* custom data passed to
+	                                             xopt_parse_cb() */
+	const char              **err);           /* err output; setting it stops
+	                                             the parse */
+
 enum xoptOptionFlag {
 	XOPT_TYPE_STRING          = 0x1,          /* const char* type */
 	XOPT_TYPE_INT             = 0x2,          /* int type */
 	XOPT_TYPE_LONG            = 0x4,          /* long type */
 	XOPT_TYPE_FLOAT           = 0x8,          /* float type */
 	XOPT_TYPE_DOUBLE          = 0x10,         /* double type */
-	XOPT_TYPE_BOOL            = 0x20,         /* boolean (int) type */
+	XOPT_TYPE_BOOL            = 0x20,         /* boolean (int) type; without a
+	                                             callback, a long one can be set
+	                                             to false with --no-<name> */
+	XOPT_TYPE_INT32           = 0x80,         /* int32_t type */
+	XOPT_TYPE_INT64           = 0x100,        /* int64_t type */
+	XOPT_TYPE_UINT32          = 0x200,        /* uint32_t type */
+	XOPT_TYPE_UINT64          = 0x400,        /* uint64_t type */
+	XOPT_TYPE_INT32_LIST      = 0x800,        /* xoptInt32List type */
+	XOPT_TYPE_INT64_LIST      = 0x1000,       /* xoptInt64List type */
+	XOPT_TYPE_DOUBLE_LIST     = 0x2000,       /* xoptDoubleList type */
+	XOPT_TYPE_ENUM            = 0x8000,       /* int type, set to the value of
+	                                             the matching `choices' entry */
+	XOPT_TYPE_FLAGS           = 0x10000,      /* uint64_t type (or an array of
+	                                             them, for bits past 63, which
+	                                             must hold max bit / 64 + 1 of
+	                                             them); a list of `choices'
+	                                             names whose values are bit
+	                                             numbers (0 or more), each set,
+	                                             or cleared when prefixed with
+	                                             '-' */
+	XOPT_TYPE_MAP             = 0x20000,      /* xoptMap* type; collects
+	                                             key=value pairs (see
+	                                             xopt_map_get()); the key can't
+	                                             be empty */
+	XOPT_TYPE_SIZE            = 0x100000,     /* uint64_t bytes; an integer with
+	                                             an optional SI (k, M, G, T, P,
+	                                             E) or IEC (Ki, Mi, ...) suffix,
+	                                             optionally followed by B */
+	XOPT_TYPE_DURATION        = 0x200000,     /* uint64_t nanoseconds; integers
+	                                             with units (ns, us, ms, s, m,
+	                                             h), summed, e.g. 1h30m */
+	XOPT_TYPE_COUNTER         = 0x400000,     /* int type, takes no value and is
+	                                             incremented by every occurrence
+	                                             (so -vvv gives 3) */
+
+	XOPT_MAP_KEEPFIRST        = 0x40000,      /* for a repeated map key, keep the
+	                                             first value (the last wins by
+	                                             default) */
+	XOPT_MAP_UNIQUE           = 0x80000,      /* fail on a repeated map key */
+
+	XOPT_REPEAT               = 0x4000,       /* accumulate every occurrence of
+	                                             a string, int32, int64 or double
+	                                             (or list) option into an
+	                                             xopt*List instead of keeping
+	                                             the last; xopt_context() fails
+	                                             for any other type */
 
 	XOPT_OPTIONAL             = 0x40          /* whether the argument value is
 	                                             optional */
 };
 
+/* list (or flag) delimiter (ASCII; ',' if not given), or'd into `options' */
+#define XOPT_DELIM(c) ((long) (c) << 24)
+
 enum xoptContextFlag {
 	XOPT_CTX_KEEPFIRST        = 0x1,          /* don't ignore argv[0] */
 	XOPT_CTX_POSIXMEHARDER    = 0x2,          /* options cannot come after
@@ -71,6 +135,62 @@ enum xoptContextFlag {
 	XOPT_CTX_STRICT           = 0x10          /* fails on invalid arguments */
 };
 
+enum xoptErrorCode {
+	XOPT_ERR_NONE             = 0,            /* no error */
+	XOPT_ERR_NOMEM,                           /* an allocation failed */
+	XOPT_ERR_INVALID,                         /* unknown option */
+	XOPT_ERR_CONDENSED,                       /* short options were combined
+	                                             under XOPT_CTX_NOCONDENSE */
+	XOPT_ERR_UNEXPECTED_VALUE,                /* value given to an option that
+	                                             doesn't take one */
+	XOPT_ERR_MISSING_VALUE,                   /* option requires a value */
+	XOPT_ERR_NOT_LAST,                        /* condensed short option requiring
+	                                             a value wasn't the last one */
+	XOPT_ERR_AFTER_EXTRAS,                    /* option came after an extra under
+	                                             XOPT_CTX_POSIXMEHARDER */
+	XOPT_ERR_NUMBER,                          /* value isn't a valid number */
+	XOPT_ERR_RANGE,                           /* number doesn't fit the option's
+	                                             type */
+	XOPT_ERR_NOSPACE,                         /* caller-supplied extras buffer
+	                                             is too small */
+	XOPT_ERR_CALLBACK,                        /* an xoptCallback reported an
+	                                             error (see `message') */
+	XOPT_ERR_CHOICE,                          /* value isn't one of the option's
+	                                             choices */
+	XOPT_ERR_DUPLICATE,                       /* repeated key given to an
+	                                             XOPT_MAP_UNIQUE map */
+	XOPT_ERR_VALUE                            /* malformed value, such as a map
+	                                             entry with an empty key */
+};
+
+enum xoptNextKind {
+	XOPT_NEXT_ERROR           = -1,           /* parse error (see `error') */
+	XOPT_NEXT_END             = 0,            /* no arguments left */
+	XOPT_NEXT_OPTION,                         /* an option (and its value, if
+	                                             any) was found */
+	XOPT_NEXT_EXTRA                           /* a non-option argument was
+	                                             found */
+};
+
+typedef enum xoptShell {
+	XOPT_SHELL_BASH,                          /* bash, for `complete -F' */
+	XOPT_SHELL_ZSH,                           /* zsh, sourced after compinit */
+	XOPT_SHELL_FISH                           /* fish, a list of `complete' */
+} xoptShell;
+
+/**
+ * A named value for options with a fixed
+ * vocabulary (see XOPT_TYPE_ENUM).
+ */
+typedef struct xoptChoice {
+	const char                *name;          /* the name given on the command
+	                                             line */
+	int                       value;          /* what it stands for */
+} xoptChoice;
+
+/* choice list terminator */
+#define XOPT_NULLCHOICE {0, 0}
+
 typedef struct xoptOption {
 	const char                *longArg;       /* --long-arg-name, or 0 for short
 	                                             arg only */
@@ -83,13 +203,115 @@ typedef struct xoptOption {
 	long                      options;        /* xoptOptionFlag options */
 	const char                *argDescrip;    /* --argument=argDescrip (autohelp) */
 	const char                *descrip;       /* argument explanation (autohelp) */
+	const xoptChoice          *choices;       /* valid values, terminated with
+	                                             XOPT_NULLCHOICE, or 0 */
 } xoptOption;
 
 /* option list terminator */
-#define XOPT_NULLOPTION {0, 0, 0, 0, 0, 0, 0}
+#define XOPT_NULLOPTION {0, 0, 0, 0, 0, 0, 0, 0}
+
+/**
+ * Targets of the list types and of repeated
+ * options. `items' points into memory owned
+ * by the parse result, and stays valid
+ * until xopt_result_free().
+ */
+typedef struct xoptStringList {
+	const char                **items;
+	size_t                    count;
+} xoptStringList;
+
+typedef struct xoptInt32List {
+	int32_t                   *items;
+	size_t                    count;
+} xoptInt32List;
+
+typedef struct xoptInt64List {
+	int64_t                   *items;
+	size_t                    count;
+} xoptInt64List;
+
+typedef struct xoptDoubleList {
+	double                    *items;
+	size_t                    count;
+} xoptDoubleList;
+
+/**
+ * Structured description of a parse error.
+ *  Nothing is formatted when an error occurs;
+ *  use xopt_strerror() to get a message.
+ */
+typedef struct xoptError {
+	int                       code;           /* xoptErrorCode code */
+	int                       argi;           /* index of the offending argument
+	                                             in argv */
+	const char                *arg;           /* the offending argument
+	                                             (argv[argi]), or 0 */
+	size_t                    offset;         /* byte offset into `arg' at which
+	                                             the problem was found */
+	const xoptOption          *option;        /* the option involved, or 0 if it
+	                                             couldn't be resolved */
+	bool                      longArg;        /* true if the long-arg version
+	                                             was used */
+	const char                *message;       /* static message for
+	                                             XOPT_ERR_NOMEM, or the string
+	                                             reported by a callback */
+} xoptError;
+
+/**
+ * Pull-style iterator over a command line.
+ *  Lives wherever the caller puts it (usually
+ *  the stack); see xopt_iter_init() and
+ *  xopt_next(). Besides `argi', `longArg',
+ *  `negated' and `error', the members are
+ *  private.
+ */
+typedef struct xoptIterator {
+	const struct xoptContext  *ctx;
+	int                       argc;
+	const char                **argv;
+	int                       argi;           /* index of the argument the last
+	                                             item (or its value) came from */
+	const char                *group;         /* remaining condensed short
+	                                             options, or 0 */
+	int                       groupArgi;      /* index of the argument `group'
+	                                             points into */
+	bool                      longArg;        /* true if the last option was
+	                                             given in its long form */
+	bool                      negated;        /* true if the last option was a
+	                                             boolean given as --no-<name> */
+	bool                      doubledash;
+	bool                      sawExtra;
+	xoptError                 error;          /* error record; `code' is
+	                                             XOPT_ERR_NONE unless
+	                                             XOPT_NEXT_ERROR was returned */
+} xoptIterator;
+
+/**
+ * Per-call output of the reentrant
+ * parsing functions.
+ */
+typedef struct xoptResult {
+	const char                **extras;       /* 0-terminated list of extra
+	                                             non-option arguments */
+	int                       extrasCount;    /* number of extras */
+	bool                      ownsExtras;     /* true if `extras' was allocated
+	                                             by the parse */
+	struct xoptArena          *arena;         /* memory behind list and
+	                                             repeated values (private) */
+	xoptError                 error;          /* error record; `code' is
+	                                             XOPT_ERR_NONE on success */
+} xoptResult;
 
 typedef struct xoptContext xoptContext;
 
+/**
+ * Key=value pairs collected by an
+ * XOPT_TYPE_MAP option, owned by the parse
+ * result (like list values).
+ */
+typedef struct xoptMap xoptMap;
+
 typedef struct xoptAutohelpOptions {
 	const char                *usage;         /* usage string, or null */
 	const char                *prefix;        /* printed before options, or null */
@@ -104,7 +326,16 @@ extern "C" {
 
 /**
  * Creates an XOpt context to be used with
- * subsequent calls to XOpt functions
+ * subsequent calls to XOpt functions.
+ *
+ * Parsing never modifies the context, so it
+ * can be reused for any number of parses,
+ * including concurrent ones. The help cache
+ * and the search and completion indexes are
+ * built into it lazily, under a lock (unless
+ * built with XOPT_NOTHREADS, in which case
+ * those calls must not run concurrently).
+ * Release it with xopt_context_free().
  */
 xoptContext*
 xopt_context(
@@ -118,15 +349,36 @@ xopt_context(
 	                                             set to 0 if command completed
 	                                             successfully */
 
+/**
+ * Releases a context created by xopt_context(),
+ * along with any help text and indexes it has
+ * built and its lock.
+ *
+ * Contexts used to be released with a plain
+ * free(); that now leaks what the context has
+ * built and never destroys the lock, so call
+ * this instead.
+ */
+void
+xopt_context_free(
+	xoptContext             *ctx);            /* the context, or 0 */
+
 /**
  * Parses the command line of a program
  * and returns the number of non-options
  * returned to the `extras' pointer (see
- * below)
+ * below).
+ *
+ * Error messages are formatted into a
+ * shared buffer, so concurrent calls must
+ * use xopt_parse_r() instead. Contexts with
+ * list, XOPT_REPEAT or map options always
+ * fail here, as their values need
+ * xopt_result_free(); use xopt_parse_r().
  */
 int
 xopt_parse(
-	xoptContext             *ctx,             /* previously created XOpt context */
+	const xoptContext       *ctx,             /* previously created XOpt context */
 	int                     argc,             /* argc, from int main() */
 	const char              **argv,           /* argv, from int main() */
 	void                    *data,            /* a custom data object whos type
@@ -144,15 +396,274 @@ xopt_parse(
 	                                             successfully */
 
 /**
- * Generates and prints a help message
- * and prints it to a FILE stream.
+ * Reentrant version of xopt_parse().
+ *
+ * Nothing is shared between calls, so any
+ * number of threads can parse concurrently
+ * using the same context. Returns false on
+ * error, in which case `result->error'
+ * describes the problem. On success the
+ * extras (and any list values) must be
+ * released with xopt_result_free().
+ */
+bool
+xopt_parse_r(
+	const xoptContext       *ctx,             /* previously created XOpt context */
+	int                     argc,             /* argc, from int main() */
+	const char              **argv,           /* argv, from int main() */
+	void                    *data,            /* a custom data object whos type
+	                                             corresponds to `.offset' values
+	                                             specified in the options list */
+	xoptResult              *result);         /* receives the extras and any
+	                                             error */
+
+/**
+ * Version of xopt_parse_r() that never
+ * allocates extras, writing them (and the
+ * 0 terminator) into a caller-supplied
+ * buffer instead.
+ *
+ * If the buffer is too small, the whole
+ * command line is still parsed, and false
+ * is returned with XOPT_ERR_NOSPACE and
+ * `result->extrasCount' holding the number
+ * of extras found; `extrasCount + 1' slots
+ * are required. Note that the options have
+ * still been applied to `data' in that case,
+ * so list values must still be released
+ * with xopt_result_free().
+ */
+bool
+xopt_parse_buf(
+	const xoptContext       *ctx,             /* previously created XOpt context */
+	int                     argc,             /* argc, from int main() */
+	const char              **argv,           /* argv, from int main() */
+	void                    *data,            /* a custom data object whos type
+	                                             corresponds to `.offset' values
+	                                             specified in the options list */
+	const char              **extras,         /* buffer that receives the extras */
+	size_t                  capacity,         /* number of entries in `extras' */
+	xoptResult              *result);         /* receives the extras count and
+	                                             any error */
+
+/**
+ * Version of xopt_parse_r() that hands each
+ * extra to a callback as it's found instead
+ * of collecting them, so memory use doesn't
+ * depend on the number of extras.
+ *
+ * `result->extras' is always 0;
+ * `result->extrasCount' still receives the
+ * number of extras.
+ */
+bool
+xopt_parse_cb(
+	const xoptContext       *ctx,             /* previously created XOpt context */
+	int                     argc,             /* argc, from int main() */
+	const char              **argv,           /* argv, from int main() */
+	void                    *data,            /* a custom data object whos type
+	                                             corresponds to `.offset' values
+	                                             specified in the options list */
+	xoptExtraCallback       callback,         /* receives each extra */
+	void                    *callbackData,    /* passed through to `callback' */
+	xoptResult              *result);         /* receives the extras count and
+	                                             any error */
+
+/**
+ * Parses `count' command lines in one go,
+ * using the same rules as xopt_parse_r().
+ *
+ * Command line `i' is applied to the data
+ * object at `data + i * stride', and its
+ * result goes to `results[i]' (a failed
+ * line has a non-zero `error.code' and
+ * doesn't stop the others). All extras go
+ * into the single `extras' buffer, which
+ * must have room for `argc[i] + 1' entries
+ * per command line; each result's `extras'
+ * points into it, so xopt_result_free()
+ * is only needed for list values.
+ *
+ * Returns the number of command lines that
+ * failed to parse.
+ */
+size_t
+xopt_parse_batch(
+	const xoptContext       *ctx,             /* previously created XOpt context */
+	size_t                  count,            /* number of command lines */
+	const int               *argc,            /* `count' argument counts */
+	const char              ***argv,          /* `count' argument vectors */
+	void                    *data,            /* first of `count' data objects */
+	size_t                  stride,           /* distance between data objects, in
+	                                             bytes (usually their sizeof) */
+	const char              **extras,         /* receives the extras of every
+	                                             command line */
+	xoptResult              *results);        /* `count' results */
+
+/**
+ * Multi-threaded version of
+ * xopt_parse_batch(), with identical
+ * results. Command lines are spread over
+ * `threads' threads (the calling thread
+ * being one of them), which steal work
+ * from each other as they run out, so very
+ * uneven command lines still balance out.
+ *
+ * The data objects must not overlap, and
+ * any callbacks must be thread-safe.
+ * Without thread support (XOPT_NOTHREADS)
+ * this is the same as xopt_parse_batch().
+ */
+size_t
+xopt_parse_batch_mt(
+	const xoptContext       *ctx,             /* previously created XOpt context */
+	size_t                  count,            /* number of command lines */
+	const int               *argc,            /* `count' argument counts */
+	const char              ***argv,          /* `count' argument vectors */
+	void                    *data,            /* first of `count' data objects */
+	size_t                  stride,           /* distance between data objects, in
+	                                             bytes (usually their sizeof) */
+	const char              **extras,         /* receives the extras of every
+	                                             command line */
+	xoptResult              *results,         /* `count' results */
+	unsigned                threads);         /* number of threads to use, or 0
+	                                             for one per online CPU */
+
+/**
+ * Prepares an iterator over a command line.
+ *  Nothing is allocated, and nothing needs
+ *  to be released afterwards.
+ */
+void
+xopt_iter_init(
+	xoptIterator            *it,              /* the iterator to initialize */
+	const xoptContext       *ctx,             /* previously created XOpt context */
+	int                     argc,             /* argc, from int main() */
+	const char              **argv);          /* argv, from int main() */
+
+/**
+ * Resolves the next option or extra, using
+ * the same rules as xopt_parse(), and returns
+ * its xoptNextKind. Nothing is written to a
+ * data object and no callbacks are invoked,
+ * so the caller can stop at any point (e.g.
+ * at the first subcommand).
+ */
+int
+xopt_next(
+	xoptIterator            *it,              /* iterator from xopt_iter_init() */
+	const xoptOption        **option,         /* receives the option, or 0 for an
+	                                             extra */
+	const char              **value);         /* receives the option's value (or
+	                                             0 if it has none), or the extra */
+
+/**
+ * Releases anything allocated into a
+ * result by a parse
+ */
+void
+xopt_result_free(
+	xoptResult              *result);         /* a result filled by a parse */
+
+/**
+ * Looks up a key in a map filled by an
+ * XOPT_TYPE_MAP option and returns its value,
+ * or 0 if the key wasn't given. A key given
+ * without `=' has an empty value.
+ */
+const char *
+xopt_map_get(
+	const xoptMap           *map,             /* the map, or 0 (no keys) */
+	const char              *key);            /* key to look up */
+
+/**
+ * Returns the number of distinct keys in a
+ * map (which may be 0)
+ */
+size_t
+xopt_map_count(
+	const xoptMap           *map);            /* the map, or 0 (no keys) */
+
+/**
+ * Gets a map entry by position, in the order
+ * keys were first given. Keys point into
+ * argv and aren't 0-terminated.
+ */
+bool
+xopt_map_entry(
+	const xoptMap           *map,             /* the map, or 0 (no keys) */
+	size_t                  index,            /* position, below xopt_map_count() */
+	const char              **key,            /* receives the key */
+	size_t                  *keyLength,       /* receives the key's length */
+	const char              **value);         /* receives the value */
+
+/**
+ * Formats an error record into `buf'
+ * and returns `buf'
+ */
+const char *
+xopt_strerror(
+	const xoptError         *error,           /* the error to describe */
+	char                    *buf,             /* receives the message */
+	size_t                  size);            /* size of `buf', in bytes */
+
+/**
+ * Renders the help message xopt_autohelp()
+ * prints into `buf' instead, for embedding
+ * it elsewhere. Like snprintf(), writes at
+ * most `size' bytes (including the 0
+ * terminator) and returns the full length
+ * of the text - call with a `size' of 0 to
+ * measure it first.
+ *
+ * Given a number of `columns', text is
+ * wrapped to fit (see xopt_autohelp_wrap()).
+ */
+size_t
+xopt_autohelp_render(
+	const xoptContext           *ctx,         /* previously created XOpt context */
+	const xoptAutohelpOptions   *options,     /* configuration options to tailor
+	                                             autohelp output, or 0 */
+	size_t                      columns,      /* width to wrap to, or 0 to not
+	                                             wrap */
+	char                        *buf,         /* receives the help text */
+	size_t                      size);        /* size of `buf', in bytes */
+
+/**
+ * Returns the help message xopt_autohelp()
+ * prints. It's cached in the context, so
+ * repeat calls (from any thread) return the
+ * same immutable text. Only the latest
+ * `columns' are kept for each set of autohelp
+ * options, though: the text stays valid until
+ * help is asked for with the same options but
+ * other columns, or until xopt_context_free().
+ */
+const char *
+xopt_autohelp_text(
+	const xoptContext           *ctx,         /* previously created XOpt context */
+	const xoptAutohelpOptions   *options,     /* configuration options to tailor
+	                                             autohelp output, or 0 */
+	size_t                      columns,      /* width to wrap to, or 0 to not
+	                                             wrap */
+	size_t                      *length,      /* receives the length of the text */
+	const char                  **err);       /* pointer to a const char* that
+	                                             receives an err should one occur -
+	                                             set to 0 if command completed
+	                                             successfully */
+
+/**
+ * Generates a help message and prints it
+ * to a FILE stream with a single write.
+ * The text is cached in the context (see
+ * xopt_autohelp_text()).
  * If `defaults' is supplied, uses
  * offsets (values) defined by the options
  * list to show default options
  */
 void
 xopt_autohelp(
-	xoptContext                 *ctx,         /* previously created XOpt context */
+	const xoptContext           *ctx,         /* previously created XOpt context */
 	FILE                        *stream,      /* a stream to print to - if 0,
 	                                             defaults to `stderr'. */
 	const xoptAutohelpOptions   *options,     /* configuration options to tailor
@@ -162,6 +673,128 @@ xopt_autohelp(
 	                                             set to 0 if command completed
 	                                             successfully */
 
+/**
+ * Like xopt_autohelp(), but wraps the text to
+ * `columns' display columns (counting UTF-8
+ * characters, and double width ones as two).
+ * Descriptions wrap with a hanging indent, and
+ * options too wide to leave them room get
+ * theirs on the next line.
+ */
+void
+xopt_autohelp_wrap(
+	const xoptContext           *ctx,         /* previously created XOpt context */
+	FILE                        *stream,      /* a stream to print to - if 0,
+	                                             defaults to `stderr'. */
+	const xoptAutohelpOptions   *options,     /* configuration options to tailor
+	                                             autohelp output */
+	size_t                      columns,      /* width to wrap to - if 0, the
+	                                             terminal's width, $COLUMNS or
+	                                             80, in that order */
+	const char                  **err);       /* pointer to a const char* that
+	                                             receives an err should one occur -
+	                                             set to 0 if command completed
+	                                             successfully */
+
+/**
+ * Finds the options whose long name,
+ * argDescrip or descrip contain `keyword'
+ * (ignoring ASCII case), in table order.
+ * Returns how many there are, storing the
+ * indexes (into the options list) of up to
+ * `max' of them. The index this searches is
+ * built on the first call and kept in the
+ * context.
+ */
+size_t
+xopt_search(
+	const xoptContext           *ctx,         /* previously created XOpt context */
+	const char                  *keyword,     /* text to look for */
+	int                         *matches,     /* receives the matching options'
+	                                             indexes */
+	size_t                      max,          /* capacity of `matches' */
+	const char                  **err);       /* pointer to a const char* that
+	                                             receives an err should one occur -
+	                                             set to 0 if command completed
+	                                             successfully */
+
+/**
+ * Like xopt_autohelp(), but only lists the
+ * options xopt_search() finds for `keyword'
+ * (e.g. for --help=<keyword>). Returns the
+ * number of options listed.
+ */
+size_t
+xopt_autohelp_search(
+	const xoptContext           *ctx,         /* previously created XOpt context */
+	FILE                        *stream,      /* a stream to print to - if 0,
+	                                             defaults to `stderr'. */
+	const xoptAutohelpOptions   *options,     /* configuration options to tailor
+	                                             autohelp output */
+	const char                  *keyword,     /* text to look for */
+	size_t                      columns,      /* width to wrap to, or 0 to not
+	                                             wrap */
+	const char                  **err);       /* pointer to a const char* that
+	                                             receives an err should one occur -
+	                                             set to 0 if command completed
+	                                             successfully */
+
+/**
+ * Completes a partial long option (with or
+ * without its leading `--'), returning the
+ * number of long names starting with it and
+ * storing up to `max' of them (without the
+ * dashes), in sorted order; booleans also
+ * offer their `no-<name>'. For a partial
+ * `--name=value', completes the option's
+ * choices instead. The index of names this
+ * searches is built on the first call and
+ * kept in the context.
+ */
+size_t
+xopt_complete(
+	const xoptContext           *ctx,         /* previously created XOpt context */
+	const char                  *partial,     /* the word being completed */
+	const char                  **matches,    /* receives the matching names,
+	                                             owned by the options list */
+	size_t                      max,          /* capacity of `matches' */
+	const char                  **err);       /* pointer to a const char* that
+	                                             receives an err should one occur -
+	                                             set to 0 if command completed
+	                                             successfully */
+
+/**
+ * Generates a completion script for `shell'
+ * from the options list, into `buf'. Like
+ * xopt_autohelp_render(), returns the full
+ * length of the script, writing at most
+ * `size' bytes (including the 0 terminator).
+ * The script is bound to the basename of the
+ * context's name, so argv[0] is fine.
+ */
+size_t
+xopt_completion_render(
+	const xoptContext           *ctx,         /* previously created XOpt context */
+	xoptShell                   shell,        /* which shell to generate for */
+	char                        *buf,         /* receives the script */
+	size_t                      size);        /* size of `buf', in bytes */
+
+/**
+ * Generates a completion script for `shell'
+ * and prints it to a FILE stream (e.g. for a
+ * --completion=<shell> option).
+ */
+void
+xopt_completion(
+	const xoptContext           *ctx,         /* previously created XOpt context */
+	FILE                        *stream,      /* a stream to print to - if 0,
+	                                             defaults to `stdout'. */
+	xoptShell                   shell,        /* which shell to generate for */
+	const char                  **err);       /* pointer to a const char* that
+	                                             receives an err should one occur -
+	                                             set to 0 if command completed
+	                                             successfully */
+
 /**
  * Generates a default option parser that's sane for most cases.
  *
@@ -174,6 +807,9 @@ xopt_autohelp(
  *
  * To be extra clear, you need to free `extrav_ptr` is if `*err_ptr` is not `NULL`.
  *
+ * This goes through `xopt_parse()`, so it fails for options lists with list, `XOPT_REPEAT` or
+ * map options; parse those with `xopt_parse_r()` and `xopt_result_free()`.
+ *
  * `name` is the name of the binary you'd like to pass to the context (welcome to use `argv[0]` here),
  * `options` is a reference to the xoptOptions array you've specified,
  * `config_ptr` is a *pointer* to your configuration instance,
@@ -215,11 +851,11 @@ xopt_autohelp(
 		} \
 	\
 	__xopt_end_free_ctx: \
-		free(_xopt_ctx); \
+		xopt_context_free(_xopt_ctx); \
 		break; \
 	__xopt_end_free_extrav: \
 		free(*(extrav_ptr)); \
-		free(_xopt_ctx); \
+		xopt_context_free(_xopt_ctx); \
 		break; \
 	} while (false)
 